@@ -0,0 +1,98 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Dynamic bounding volume hierarchy of boxes (fattened by margin so small moves don't require reinsert)
+class AabbTree
+{
+public:
+	static constexpr int INVALID = -1;
+
+	AabbTree(float margin = 0.5f);
+	int Insert(const Box& box, void* data);
+	void Remove(int proxy);
+	// Update box of proxy, return true if it was reinserted
+	bool Move(int proxy, const Box& box);
+	void Clear();
+	void* GetData(int proxy) const { assert(IsValid(proxy)); return nodes[proxy].data; }
+	const Box& GetFatBox(int proxy) const { assert(IsValid(proxy)); return nodes[proxy].box; }
+	uint GetCount() const { return count; }
+	// Call func(data, inside) for every proxy that collide with frustum, inside is true when fat box is fully inside
+	// (whole subtrees fully inside frustum aren't tested)
+	template<typename Func>
+	void Query(const FrustumPlanes& frustum, Func func) const;
+
+private:
+	struct Node
+	{
+		Box box;
+		void* data;
+		union
+		{
+			int parent;
+			int next;
+		};
+		int child1, child2;
+		int height; // -1 for free node
+
+		bool IsLeaf() const { return child1 == INVALID; }
+	};
+
+	bool IsValid(int proxy) const { return proxy >= 0 && proxy < (int)nodes.size() && nodes[proxy].height >= 0; }
+	int AllocateNode();
+	void FreeNode(int index);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	int Balance(int index);
+	void Refit(int index);
+	template<typename Func>
+	void QueryAll(int index, Func& func) const;
+
+	vector<Node> nodes;
+	mutable vector<int> stack;
+	int root, freeList;
+	uint count;
+	float margin;
+};
+
+//-----------------------------------------------------------------------------
+template<typename Func>
+inline void AabbTree::Query(const FrustumPlanes& frustum, Func func) const
+{
+	if(root == INVALID)
+		return;
+
+	stack.clear();
+	stack.push_back(root);
+	while(!stack.empty())
+	{
+		const int index = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[index];
+		if(frustum.BoxInFrustum(node.box))
+			QueryAll(index, func);
+		else if(frustum.BoxToFrustum(node.box))
+		{
+			if(node.IsLeaf())
+				func(node.data, false);
+			else
+			{
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+template<typename Func>
+inline void AabbTree::QueryAll(int index, Func& func) const
+{
+	const Node& node = nodes[index];
+	if(node.IsLeaf())
+		func(node.data, true);
+	else
+	{
+		QueryAll(node.child1, func);
+		QueryAll(node.child2, func);
+	}
+}
@@ -25,6 +25,7 @@ struct SceneNodeGroup;
 struct SimpleMesh;
 struct TaskData;
 struct Terrain;
+struct TerrainPartLod;
 struct TrailParticleEmitter;
 class App;
 class BasicShader;
@@ -48,6 +49,7 @@ class SkyboxShader;
 class SoundManager;
 class SuperShader;
 class TerrainShader;
+class ThreadPool;
 typedef SceneNode* SceneNodePtr;
 
 // Resource types
@@ -157,4 +159,5 @@ namespace app
 	extern ResourceManager* resMgr;
 	extern SceneManager* sceneMgr;
 	extern SoundManager* soundMgr;
+	extern ThreadPool* threadPool;
 }
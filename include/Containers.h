@@ -319,6 +319,7 @@ void CopyItems(vector<T>& items, const array<T, N>& arr)
 struct ObjectPoolLeakManager
 {
 	struct CallStackEntry;
+	ObjectPoolLeakManager() { cs.Create(); }
 	~ObjectPoolLeakManager();
 	void Register(void* ptr);
 	void Unregister(void* ptr);
@@ -326,6 +327,7 @@ struct ObjectPoolLeakManager
 private:
 	vector<CallStackEntry*> callStackPool;
 	std::unordered_map<void*, CallStackEntry*> callStacks;
+	CriticalSection cs;
 };
 #endif
 
@@ -502,7 +504,74 @@ private:
 	bool destroyed;
 };
 
+//-----------------------------------------------------------------------------
+// Object pool that can be used from multiple threads
 template<typename T>
+struct SafeObjectPool
+{
+	SafeObjectPool() : destroyed(false)
+	{
+		cs.Create();
+	}
+	~SafeObjectPool()
+	{
+		cs.Free();
+		destroyed = true;
+	}
+
+	T* Get()
+	{
+		StartCriticalSection section(cs);
+		return pool.Get();
+	}
+
+	void Free(T* e)
+	{
+		StartCriticalSection section(cs);
+		pool.Free(e);
+	}
+
+	void Free(vector<T*>& elems)
+	{
+		StartCriticalSection section(cs);
+		pool.Free(elems);
+	}
+
+	void SafeFree(T* e)
+	{
+		if(destroyed)
+			pool.SafeFree(e);
+		else
+		{
+			StartCriticalSection section(cs);
+			pool.SafeFree(e);
+		}
+	}
+
+	void SafeFree(vector<T*>& elems)
+	{
+		if(destroyed)
+			pool.SafeFree(elems);
+		else
+		{
+			StartCriticalSection section(cs);
+			pool.SafeFree(elems);
+		}
+	}
+
+	void Cleanup()
+	{
+		StartCriticalSection section(cs);
+		pool.Cleanup();
+	}
+
+private:
+	ObjectPool<T> pool;
+	CriticalSection cs;
+	bool destroyed;
+};
+
+template<typename T, typename Pool = ObjectPool<T>>
 class ObjectPoolProxy
 {
 	friend struct ObjectPool<T>;
@@ -520,14 +589,14 @@ protected:
 	ObjectPoolProxy() {}
 	~ObjectPoolProxy() {}
 private:
-	static ObjectPool<T>& GetPool() { static ObjectPool<T> pool; return pool; }
+	static Pool& GetPool() { static Pool pool; return pool; }
 };
 
 template<typename T>
 class Pooled
 {
 public:
-	Pooled() { ptr = ObjectPoolProxy<T>::Get(); }
+	Pooled() { ptr = T::Get(); }
 	Pooled(T* ptr) : ptr(ptr) {}
 	~Pooled() { if(ptr) ptr->Free(); }
 	T* operator -> () { return ptr; }
@@ -1368,7 +1437,8 @@ struct PointerVector
 
 //-----------------------------------------------------------------------------
 // Buffer - used by MemoryStream
-class Buffer : public ObjectPoolProxy<Buffer>
+// Buffers are shared with resource loading threads so pool is thread safe
+class Buffer : public ObjectPoolProxy<Buffer, SafeObjectPool<Buffer>>
 {
 public:
 	void Append(void* ptr, uint size)
@@ -1396,7 +1466,7 @@ public:
 	Buffer* Compress();
 	// Compress to new buffer and return it if worth it, otherwise return old buffer
 	Buffer* TryCompress();
-	// Decompress buffer to new buffer and return it, old one is freed
+	// Decompress buffer to new buffer and return it (nullptr when data is corrupted), old one is freed
 	Buffer* Decompress(uint realSize);
 	void Resize(uint size) { data.resize(size); }
 	uint Size() const { return data.size(); }
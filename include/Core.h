@@ -55,8 +55,10 @@ typedef const char* cstring;
 //-----------------------------------------------------------------------------
 // Forward declarations
 class Buffer;
+class BufferedFileReader;
 class Config;
 class Crc;
+class FileMapping;
 class FileReader;
 class FileWriter;
 class MemoryReader;
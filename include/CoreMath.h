@@ -479,6 +479,8 @@ inline constexpr int Join3(int a, int b, int c)
 uint Hash(const string& str);
 uint Hash(cstring str);
 uint Hash(const void* ptr, uint size);
+// case insensitive (ascii) version, same result for strings that compare equal with _stricmp
+uint HashNoCase(cstring str);
 
 //-----------------------------------------------------------------------------
 // check for overflow a + b, and return value
@@ -1487,6 +1489,57 @@ struct FrustumPlanes
 	bool SphereToFrustum(const Vec3& sphereCenter, float sphereRadius) const;
 	// Checks if sphere is fully inside frustum
 	bool SphereInFrustum(const Vec3& sphereCenter, float sphereRadius) const;
+	// Batch versions of SphereToFrustum/BoxToFrustum, objects are passed as structure of arrays and tested 4 at once,
+	// bit i of result is set when object i collide with frustum (result must have (count + 31) / 32 elements)
+	void SpheresToFrustum(const float* x, const float* y, const float* z, const float* radius, uint count, uint* result) const;
+	void BoxesToFrustum(const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ,
+		uint count, uint* result) const;
+};
+
+//-----------------------------------------------------------------------------
+// Spheres stored as structure of arrays for FrustumPlanes::SpheresToFrustum
+//-----------------------------------------------------------------------------
+struct SphereBatch
+{
+	vector<float> x, y, z, radius;
+	vector<uint> result;
+
+	void Clear() { x.clear(); y.clear(); z.clear(); radius.clear(); }
+	void Add(const Vec3& pos, float r) { x.push_back(pos.x); y.push_back(pos.y); z.push_back(pos.z); radius.push_back(r); }
+	uint Size() const { return (uint)x.size(); }
+	void Test(const FrustumPlanes& frustum)
+	{
+		if(Size() == 0)
+			return;
+		result.resize((Size() + 31) / 32);
+		frustum.SpheresToFrustum(x.data(), y.data(), z.data(), radius.data(), Size(), result.data());
+	}
+	bool IsVisible(uint index) const { return ((result[index / 32] >> (index % 32)) & 1) != 0; }
+};
+
+//-----------------------------------------------------------------------------
+// Boxes stored as structure of arrays for FrustumPlanes::BoxesToFrustum
+//-----------------------------------------------------------------------------
+struct BoxBatch
+{
+	vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	vector<uint> result;
+
+	void Clear() { minX.clear(); minY.clear(); minZ.clear(); maxX.clear(); maxY.clear(); maxZ.clear(); }
+	void Add(const Box& box)
+	{
+		minX.push_back(box.v1.x); minY.push_back(box.v1.y); minZ.push_back(box.v1.z);
+		maxX.push_back(box.v2.x); maxY.push_back(box.v2.y); maxZ.push_back(box.v2.z);
+	}
+	uint Size() const { return (uint)minX.size(); }
+	void Test(const FrustumPlanes& frustum)
+	{
+		if(Size() == 0)
+			return;
+		result.resize((Size() + 31) / 32);
+		frustum.BoxesToFrustum(minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data(), Size(), result.data());
+	}
+	bool IsVisible(uint index) const { return ((result[index / 32] >> (index % 32)) & 1) != 0; }
 };
 
 //-----------------------------------------------------------------------------
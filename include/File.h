@@ -45,6 +45,8 @@ namespace io
 	Buffer* Compress(byte* data, uint size);
 	// Compress or return nullptr if result is bigger
 	Buffer* TryCompress(byte* data, uint size);
+	// Decompress data to new buffer, returns nullptr when data is corrupted
+	Buffer* Decompress(const byte* data, uint size, uint realSize);
 }
 
 //-----------------------------------------------------------------------------
@@ -333,7 +335,7 @@ public:
 
 protected:
 	bool ok;
-	static string buf;
+	static thread_local string buf;
 };
 
 //-----------------------------------------------------------------------------
@@ -352,6 +354,8 @@ public:
 	bool Open(Cstring filename);
 	void Close();
 	void Read(void* ptr, uint size) override final;
+	// Read at offset, can be used from multiple threads (file position is undefined after it, use SetPos before sequential Read)
+	bool ReadAt(uint offset, void* ptr, uint size) const;
 	void ReadToString(string& s);
 	static Buffer* ReadToBuffer(Cstring path);
 	static Buffer* ReadToBuffer(Cstring path, uint offset, uint size);
@@ -369,25 +373,81 @@ protected:
 	bool ownHandle;
 };
 
+//-----------------------------------------------------------------------------
+// File reader that reads whole blocks ahead, many small reads are served from memory
+class BufferedFileReader final : public StreamReader
+{
+public:
+	static const uint DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+	explicit BufferedFileReader(uint blockSize = DEFAULT_BLOCK_SIZE);
+	explicit BufferedFileReader(Cstring filename, uint blockSize = DEFAULT_BLOCK_SIZE);
+	~BufferedFileReader();
+
+	using StreamReader::Read;
+	using StreamReader::Skip;
+	bool Open(Cstring filename);
+	void Close();
+	void Read(void* ptr, uint size) override;
+	void Skip(uint size) override;
+	uint GetSize() const override { return file.GetSize(); }
+	uint GetPos() const override { return pos; }
+	uint GetBlockSize() const { return blockSize; }
+	bool IsOpen() const { return file.IsOpen(); }
+	bool SetPos(uint pos) override;
+
+private:
+	bool FillBlock(uint offset);
+
+	FileReader file;
+	Buffer* block;
+	uint blockSize, blockOffset, blockLength, pos, filePos;
+};
+
 //-----------------------------------------------------------------------------
 class MemoryReader final : public StreamReader
 {
 public:
 	MemoryReader(BufferHandle& buf);
 	MemoryReader(Buffer* buf);
+	// Read-only view over memory that must outlive reader (nothing is copied or freed)
+	MemoryReader(const void* data, uint size);
 	~MemoryReader();
 
 	using StreamReader::Read;
 	void Read(void* ptr, uint size) override;
 	using StreamReader::Skip;
 	void Skip(uint size) override;
-	uint GetSize() const override { return buf.Size(); }
+	uint GetSize() const override { return size; }
 	uint GetPos() const override { return pos; }
 	bool SetPos(uint pos) override;
 
 private:
-	Buffer& buf;
-	uint pos;
+	Buffer* buf;
+	const byte* data;
+	uint size, pos;
+};
+
+//-----------------------------------------------------------------------------
+// Read-only memory mapping of whole file
+class FileMapping
+{
+public:
+	FileMapping() : mapping(nullptr), data(nullptr), size(0) {}
+	FileMapping(const FileMapping&) = delete;
+	~FileMapping();
+
+	bool Open(Cstring filename);
+	void Close();
+	const byte* Data() const { return data; }
+	const byte* At(uint offset) const { return data + offset; }
+	uint GetSize() const { return size; }
+	bool IsOpen() const { return data != nullptr; }
+
+private:
+	FileHandle mapping;
+	const byte* data;
+	uint size;
 };
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,39 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Uniform 3d grid of lights used to find lights that can affect object without checking all of them
+class LightGrid
+{
+public:
+	LightGrid(float cellSize = 8.f);
+	void SetCellSize(float cellSize);
+	// Update cells of lights that were added, removed, moved or changed range since last call
+	void Update(const vector<Light*>& lights);
+	void Clear();
+	// Return indices (into lights vector passed to Update) of lights that can affect sphere, sorted ascending
+	void Query(const Vec3& pos, float radius, vector<uint>& result) const;
+
+private:
+	// light covering more cells is kept in global list and returned for every query
+	static constexpr int MAX_CELLS = 256;
+
+	struct Entry
+	{
+		Light* light;
+		Vec3 pos;
+		float range;
+		int cellMin[3], cellMax[3];
+		bool global;
+	};
+
+	void GetCells(const Vec3& pos, float radius, int* cellMin, int* cellMax) const;
+	static int GetCellCount(const int* cellMin, const int* cellMax);
+	static uint64 GetKey(int x, int y, int z);
+	void Insert(uint index);
+	void Remove(uint index);
+
+	std::unordered_map<uint64, vector<uint>> cells;
+	vector<Entry> entries;
+	vector<uint> globalLights;
+	float cellSize, invCellSize;
+};
@@ -65,6 +65,7 @@ struct Mesh : public Resource
 		word parent;
 		string name;
 		vector<byte> bones;
+		bool leaf; // no other group have it as parent
 
 		static const uint MIN_SIZE = 4;
 	};
@@ -104,10 +105,25 @@ struct Mesh : public Resource
 		float length;
 		word nFrames;
 		vector<Keyframe> frames;
+		// structure of arrays copy of frames bones (index: frame * boneCount + bone - 1), used by EvaluatePose
+		vector<Vec3> framePos, frameScale;
+		vector<Quat> frameRot;
+		uint boneCount;
 
 		static const uint MIN_SIZE = 7;
 
-		int GetFrameIndex(float time, bool& hit);
+		void BuildPoseData();
+		// Calculate bone to parent matrices of bones at frame (interpolated to next frame by t when not hit)
+		void EvaluatePose(Matrix* out, const vector<byte>& bones, const Bone* meshBones, uint index, float t, bool hit) const;
+
+		int GetFrameIndex(float time, bool& hit) const;
+		// cursor is last returned frame, when time moved forward by less than frame it's found without searching
+		int GetFrameIndex(float time, bool& hit, uint& cursor) const;
+
+	private:
+		uint FindFrame(float time) const;
+		int CheckHit(uint index, float time, bool& hit) const;
+		bool InFrame(uint index, float time) const { return index + 1u < nFrames && frames[index].time <= time && time < frames[index + 1].time; }
 	};
 
 	struct Point
@@ -148,6 +164,8 @@ struct Mesh : public Resource
 
 	void SetupBoneMatrices();
 	void Load(StreamReader& stream, ID3D11Device* device);
+	Buffer* LoadData(StreamReader& stream);
+	void CreateBuffers(Buffer* data, ID3D11Device* device);
 	void LoadMetadata(StreamReader& stream);
 	void LoadHeader(StreamReader& stream);
 	void SetVertexSizeDecl();
@@ -48,7 +48,7 @@ struct MeshInstance
 
 	struct Group
 	{
-		Group() : anim(nullptr), state(0), speed(1.f), prio(0), blendMax(0.33f), frameEnd(false)
+		Group() : anim(nullptr), state(0), speed(1.f), prio(0), blendMax(0.33f), frameEnd(false), frameCursor(0)
 		{
 		}
 
@@ -60,8 +60,9 @@ struct MeshInstance
 			string* animName; // on preload
 		};
 		bool frameEnd;
+		mutable uint frameCursor; // last frame index, speeds up GetFrameIndex
 
-		int GetFrameIndex(bool& hit) const { assert(anim); return anim->GetFrameIndex(time, hit); }
+		int GetFrameIndex(bool& hit) const { assert(anim); return anim->GetFrameIndex(time, hit, frameCursor); }
 		float GetBlendT() const;
 		float GetProgress() const { return anim ? (time / anim->length) : 0; }
 		bool IsActive() const { return IsSet(state, FLAG_GROUP_ACTIVE); }
@@ -72,7 +73,17 @@ struct MeshInstance
 
 	typedef delegate<void(void*, Matrix*, int)> PredrawFunc;
 
-	explicit MeshInstance(nullptr_t) : preload(true), mesh(nullptr), needUpdate(true), ptr(nullptr), baseSpeed(1.f), matScale(nullptr) {}
+	// Animation level of detail
+	enum Lod
+	{
+		LOD_FULL, // bones updated every frame
+		LOD_REDUCED_RATE, // bones updated every few frames
+		LOD_FAR, // like LOD_REDUCED_RATE, snap to nearest keyframe & leaf bone groups stay in bind pose
+		LOD_MAX
+	};
+
+	explicit MeshInstance(nullptr_t) : preload(true), mesh(nullptr), needUpdate(true), ptr(nullptr), baseSpeed(1.f), matScale(nullptr), lod(LOD_FULL),
+		lodCounter(0), batchId(0) {}
 	explicit MeshInstance(Mesh* mesh);
 	void Play(Mesh::Animation* anim, int flags = 0, uint group = 0);
 	void Play(cstring name, int flags = 0, uint group = 0)
@@ -86,7 +97,7 @@ struct MeshInstance
 	bool IsPlaying(uint group = 0) const { return GetGroup(group).IsPlaying(); }
 	void Deactivate(uint group = 0, bool inUpdate = false);
 	void Update(float dt);
-	void SetupBones();
+	void SetupBones(Lod lod = LOD_FULL);
 	void DisableAnimations();
 	void SetToEnd(cstring anim)
 	{
@@ -129,6 +140,19 @@ struct MeshInstance
 	bool IsActive(uint group = 0) const { return GetGroup(group).IsActive(); }
 	bool IsBlending() const;
 	bool IsEnded(uint group = 0) const { return GetGroup(group).frameEnd; }
+	bool IsUpdateNeeded() const { return needUpdate; }
+	// Set lod used by scene, return true if bones should be updated in this frame
+	bool UpdateLod(Lod lod, uint rate);
+	Lod GetLod() const { return lod; }
+	// Used by SceneBatch to add instance only once, return false if it's already added
+	bool AddToBatch(uint batchId)
+	{
+		if(this->batchId == batchId)
+			return false;
+		this->batchId = batchId;
+		return true;
+	}
+	bool HavePredraw() const { return predraw != nullptr; }
 
 	void SetAnimation(Mesh::Animation* anim, float p);
 	void SetBlendMax(float value, uint group = 0);
@@ -153,5 +177,8 @@ private:
 	PredrawFunc predraw;
 	void* ptr;
 	float baseSpeed;
+	Lod lod;
+	uint lodCounter; // frames until next update with reduced rate
+	uint batchId;
 	bool needUpdate, preload;
 };
@@ -7,6 +7,9 @@
 class Pak
 {
 public:
+	static const byte CURRENT_VERSION = 2;
+	static constexpr uint CHUNK_SIZE = 64 * 1024;
+
 	enum Flags
 	{
 		Encrypted = 0x01,
@@ -32,11 +35,49 @@ public:
 		uint size;
 		uint compressedSize;
 		uint offset;
+
+		bool IsCompressed() const { return compressedSize != size; }
 	};
 
+	// Since version 2 big compressed files are stored in independently compressed chunks
+	bool IsChunked(const File& file) const { return version >= 2 && file.IsCompressed() && file.size > CHUNK_SIZE; }
+	static uint GetChunkCount(uint size) { return (size + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+
 	string path, key;
 	FileReader file;
+	FileMapping mapping; // used instead of file when pak is memory mapped
 	File* files;
 	Buffer* filenameBuf;
+	byte version;
 	bool encrypted;
 };
+
+//-----------------------------------------------------------------------------
+// Stream over single pak file entry, only chunks that are read get decrypted & decompressed
+class PakEntryReader final : public StreamReader
+{
+public:
+	PakEntryReader(Pak* pak, uint index);
+	~PakEntryReader();
+
+	using StreamReader::Read;
+	using StreamReader::Skip;
+	void Read(void* ptr, uint size) override;
+	void Skip(uint size) override;
+	uint GetSize() const override { return entry.size; }
+	uint GetPos() const override { return pos; }
+	bool SetPos(uint pos) override;
+
+private:
+	bool ReadRaw(uint offset, void* ptr, uint size);
+	bool LoadChunk(uint index, byte* dst);
+	uint GetChunkRawSize(uint index) const { return min(chunkSize, entry.size - index * chunkSize); }
+
+	Pak& pak;
+	Pak::File& entry;
+	vector<uint> chunkEnds;
+	Buffer* chunk;
+	Buffer* tmp;
+	uint pos, dataOffset, chunkSize, currentChunk;
+	bool direct;
+};
@@ -11,6 +11,7 @@ struct Billboard
 //-----------------------------------------------------------------------------
 struct ParticleEmitter
 {
+	// particle layout used in save
 	struct Particle
 	{
 		Vec3 pos, speed;
@@ -18,6 +19,13 @@ struct ParticleEmitter
 		bool exists;
 	};
 
+	// alive particles are kept in [0, alive) range
+	struct Particles
+	{
+		vector<Vec3> pos, speed;
+		vector<float> life;
+	};
+
 	TexturePtr tex;
 	Vec3 pos, speedMin, speedMax, posMin, posMax;
 	Vec2 alpha, size;
@@ -28,23 +36,40 @@ struct ParticleEmitter
 
 	// automatycznie ustawiane
 	float time, radius;
-	vector<Particle> particles;
+	Particles particles;
 	int alive;
 	bool destroy;
+	std::minstd_rand rng; // own random generator so emitters can be updated in parallel
 
 	ParticleEmitter() : manualDelete(0), gravity(true) {}
 	void Init();
-	bool Update(float dt);
+	bool Update(float dt)
+	{
+		if(!Simulate(dt))
+			return false;
+		Finish();
+		return true;
+	}
+	// Update particles without deleting emitter (safe to call in parallel for different emitters), return true when emitter finished
+	bool Simulate(float dt);
+	// Delete finished emitter or mark it for manual delete
+	void Finish();
 	void Save(FileWriter& f);
 	void Load(FileReader& f);
-	float GetAlpha(const Particle &p) const
+	float GetAlpha(int index) const
 	{
-		return Lerp(alpha.y, alpha.x, p.life / particleLife);
+		return Lerp(alpha.y, alpha.x, particles.life[index] / particleLife);
 	}
-	float GetScale(const Particle &p) const
+	float GetScale(int index) const
 	{
-		return Lerp(size.y, size.x, p.life / particleLife);
+		return Lerp(size.y, size.x, particles.life[index] / particleLife);
 	}
+
+private:
+	void UpdateParticles(float dt);
+	float RandomFloat(float a, float b) { return ((float)rng() / rng.max()) * (b - a) + a; }
+	int RandomInt(const Int2& range) { return int(rng() % (range.y - range.x + 1)) + range.x; }
+	Vec3 RandomVec3(const Vec3& a, const Vec3& b) { return Vec3(RandomFloat(a.x, b.x), RandomFloat(a.y, b.y), RandomFloat(a.z, b.z)); }
 };
 
 //-----------------------------------------------------------------------------
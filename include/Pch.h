@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <limits>
 #include <string>
+#include <string_view>
 #include <map>
 #include <set>
 #include <unordered_map>
@@ -32,6 +33,7 @@
 #include <DirectXMath.h>
 #include <array>
 #include <typeindex>
+#include <atomic>
 
 //-----------------------------------------------------------------------------
 using std::string;
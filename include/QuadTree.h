@@ -3,8 +3,9 @@
 struct QuadNode
 {
 	Box2d box;
-	Rect gridBox;
-	QuadNode* childs[4];
+	Rect gridBox; // cells [p1, p2)
+	QuadNode* childs[4]; // can be null when grid can't be split
+	float minY, maxY; // height range used in frustum tests
 	bool leaf;
 };
 
@@ -18,17 +19,21 @@ struct QuadTree
 	{
 	}
 
+	// create nodes using get (when node is null top node is created)
 	void Init(QuadNode* node, const Box2d& box, const Rect& gridBox, int splits);
 
-	void List(FrustumPlanes& frustum, Nodes& nodes);
-	void ListLeafs(FrustumPlanes& frustum, Nodes& nodes);
+	// list all visible nodes
+	void List(const FrustumPlanes& frustum, Nodes& nodes) const;
+	// list visible leafs, subtrees fully inside frustum aren't tested
+	void ListLeafs(const FrustumPlanes& frustum, Nodes& nodes) const;
 
 	// move all nodes into vector, set top to nullptr
 	void Clear(Nodes& nodes);
 
+	// return smallest node that contains whole circle or null
 	QuadNode* GetNode(const Vec2& pos, float radius);
 
 	QuadNode* top;
 	GetQuadNode get;
-	Nodes tmpNodes;
+	mutable Nodes tmpNodes;
 };
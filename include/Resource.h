@@ -5,6 +5,7 @@ enum class ResourceState
 {
 	NotLoaded,
 	Loading,
+	Queued, // waiting for ResourceManager::LoadAsync
 	Loaded
 };
 
@@ -29,11 +30,14 @@ struct Resource
 	ResourceType type;
 	Pak* pak;
 	uint pakIndex;
+	uint hash; // HashNoCase of filename, set by ResourceManager
 
 	virtual ~Resource() {}
 	bool IsFile() const { return !pak; }
 	bool IsLoaded() const { return state == ResourceState::Loaded; }
 	cstring GetPath() const;
 	Buffer* GetBuffer();
+	// Return pointer to data inside memory mapped pak or null if data must be read using GetBuffer
+	const byte* GetView(uint& size) const;
 	void EnsureIsLoaded();
 };
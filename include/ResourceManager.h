@@ -4,6 +4,7 @@
 #include "Texture.h"
 #include "Sound.h"
 #include "Timer.h"
+#include <shared_mutex>
 
 //-----------------------------------------------------------------------------
 // Task data
@@ -18,6 +19,7 @@ struct TaskData
 //-----------------------------------------------------------------------------
 typedef delegate<void(float, cstring)> ProgressCallback;
 typedef delegate<void(TaskData&)> TaskCallback;
+typedef delegate<void(Resource*)> ResourceCallback;
 
 //-----------------------------------------------------------------------------
 // Task
@@ -63,16 +65,39 @@ class ResourceManager
 		Category
 	};
 
-	struct ResourceComparer
+	// Open addressing hash table of resources (case insensitive filename), stored in single array
+	class ResourceContainer
 	{
-		bool operator () (const Resource* r1, const Resource* r2) const
+	public:
+		struct Iterator
 		{
-			return _stricmp(r1->filename, r2->filename) > 0;
-		}
-	};
+			Iterator(Resource** ptr, Resource** end) : ptr(ptr), end(end) { SkipEmpty(); }
+			bool operator != (const Iterator& it) const { return ptr != it.ptr; }
+			void operator ++ () { ++ptr; SkipEmpty(); }
+			Resource* operator * () { return *ptr; }
+
+		private:
+			void SkipEmpty() { while(ptr != end && !*ptr) ++ptr; }
+
+			Resource** ptr;
+			Resource** end;
+		};
+
+		ResourceContainer() : table(nullptr), capacity(0), count(0) {}
+		~ResourceContainer() { delete[] table; }
+		Resource* Find(cstring filename, uint hash) const;
+		// Add resource (hash must be set), return existing resource with same filename or null when added
+		Resource* Insert(Resource* res);
+		Iterator begin() { return Iterator(table, table + capacity); }
+		Iterator end() { return Iterator(table + capacity, table + capacity); }
+		uint Size() const { return count; }
 
-	typedef std::set<Resource*, ResourceComparer> ResourceContainer;
-	typedef ResourceContainer::iterator ResourceIterator;
+	private:
+		void Grow();
+
+		Resource** table;
+		uint capacity, count;
+	};
 
 	public:
 	ResourceManager();
@@ -80,7 +105,8 @@ class ResourceManager
 
 	void Init();
 	bool AddDir(cstring dir, bool subdir = true);
-	bool AddPak(cstring path, cstring key = nullptr);
+	// When mapped is set pak is memory mapped and uncompressed entries are read without copying
+	bool AddPak(cstring path, cstring key = nullptr, bool mapped = false);
 	void AddResource(Resource* res);
 	ResourceType ExtToResourceType(cstring ext);
 	ResourceType FilenameToResourceType(cstring filename);
@@ -93,6 +119,9 @@ class ResourceManager
 	bool HaveTasks() const { return !tasks.empty(); }
 	int GetLoadTasksCount() const { return toLoad; }
 	bool IsLoadScreen() const { return mode != Mode::Instant; }
+	// Set number of threads that read, decompress & parse resources during load screen (0 - load on main thread)
+	void SetLoadThreads(uint count) { assert(mode == Mode::Instant); loadThreads = count; }
+	uint GetLoadThreads() const { return loadThreads; }
 	uint VerifyResources();
 
 	// Return resource or null if missing
@@ -142,6 +171,23 @@ class ResourceManager
 		return res;
 	}
 	void LoadInstant(Resource* res);
+	// Load resource in background thread (higher priority first), callback is called from UpdateAsync when it's loaded
+	// (on failure error is logged and callback is called with resource that is still NotLoaded)
+	template<typename T>
+	T* LoadAsync(Cstring filename, int priority = 0, ResourceCallback callback = nullptr)
+	{
+		T* res = Get<T>(filename);
+		LoadAsync(res, priority, callback);
+		return res;
+	}
+	void LoadAsync(Resource* res, int priority = 0, ResourceCallback callback = nullptr);
+	void SetAsyncPriority(Resource* res, int priority);
+	// Cancel background loading, callbacks aren't called (when it's already processed state is restored to NotLoaded after it ends)
+	void CancelAsync(Resource* res);
+	// Integrate resources loaded in background, called by engine every frame until time budget is spent
+	void UpdateAsync();
+	void SetAsyncBudget(float budget) { assert(budget >= 0.f); asyncBudget = budget; }
+	uint GetAsyncCount() const { return asyncRequests.size(); }
 	void LoadMeshMetadata(Mesh* mesh);
 	TEX LoadRawTexture(cstring path);
 	TEX LoadRawTexture(Buffer* buf);
@@ -156,30 +202,68 @@ private:
 		};
 		TaskType type;
 		TaskCallback callback;
+		// result of loading thread for TaskType::Load
+		Buffer* prepared;
+		string error;
+		std::atomic<bool> ready;
 
 		TaskDetail()
 		{
 		}
 	};
 
+	struct AsyncRequest
+	{
+		Resource* res;
+		vector<ResourceCallback> callbacks;
+		int priority;
+		uint order;
+		bool canceled;
+		// result of background thread
+		Buffer* prepared;
+		string error;
+		std::atomic<bool> ready;
+
+		static bool Less(const AsyncRequest* r1, const AsyncRequest* r2)
+		{
+			if(r1->priority != r2->priority)
+				return r1->priority < r2->priority;
+			return r1->order > r2->order;
+		}
+	};
+
 	void RegisterExtensions();
 	void UpdateLoadScreen();
 	void TickLoadScreen();
+	void StartWorkers();
+	void StopWorkers();
+	void RunWorker();
+	void FinishJob(TaskDetail* task);
+	void StartAsync();
+	void StopAsync();
+	void RunAsyncWorker();
+	bool RemoveQueuedAsync(AsyncRequest* req);
+	void CompleteAsync(AsyncRequest* req, bool instant = false);
 
 	Resource* AddResource(cstring filename, cstring path);
 	Resource* CreateResource(ResourceType type);
 	Resource* TryGetResource(Cstring filename, ResourceType type);
 	Resource* GetResource(Cstring filename, ResourceType type);
 	void LoadResourceInternal(Resource* res);
+	Buffer* PrepareResource(Resource* res);
+	void FinalizeResource(Resource* res, Buffer* prepared);
 	void LoadMesh(Mesh* mesh);
+	Buffer* LoadMeshData(Mesh* mesh);
+	void CreateMesh(Mesh* mesh, Buffer* data);
 	void LoadVertexData(VertexData* vd);
 	void LoadSoundOrMusic(Sound* sound);
 	void LoadTexture(Texture* tex);
+	void LoadTexture(Texture* tex, Buffer* buf);
 	void LoadBuiltinMesh(cstring name, byte* data, uint size);
 
 	Mode mode;
 	ResourceContainer resources;
-	Resource resSearch;
+	std::shared_mutex resourcesLock; // lookups can come from background thread, inserts only from main thread
 	std::map<cstring, ResourceType, CstringComparer> exts;
 	vector<Pak*> paks;
 	vector<TaskDetail*> tasks;
@@ -189,5 +273,18 @@ private:
 	float timerDt, progress, progressMin, progressMax;
 	ProgressCallback progressClbk;
 	ObjectPool<TaskDetail> taskPool;
-	Mesh* tmpMesh;
+	vector<thread> workers;
+	vector<TaskDetail*> jobs;
+	std::atomic<uint> nextJob;
+	uint loadThreads;
+	// background loading, queue & done are guarded by asyncCs
+	ObjectPool<AsyncRequest> asyncPool;
+	std::unordered_map<Resource*, AsyncRequest*> asyncRequests;
+	vector<AsyncRequest*> asyncQueue, asyncDone;
+	CriticalSection asyncCs;
+	thread asyncThread;
+	void* asyncEvent;
+	float asyncBudget;
+	uint asyncOrder;
+	bool asyncQuit;
 };
@@ -1,18 +1,16 @@
 #pragma once
 
 //-----------------------------------------------------------------------------
+#include "AabbTree.h"
 #include "Light.h"
+#include "LightGrid.h"
 
 //-----------------------------------------------------------------------------
 struct Scene
 {
 	Scene();
 	~Scene();
-	void Add(SceneNode* node)
-	{
-		assert(node);
-		nodes.push_back(node);
-	}
+	void Add(SceneNode* node);
 	void Add(ParticleEmitter* particleEmitter)
 	{
 		assert(particleEmitter);
@@ -20,9 +18,12 @@ struct Scene
 	}
 	void Remove(SceneNode* node);
 	void Detach(SceneNode* node);
+	// Call after changing node position or radius
+	void UpdateNode(SceneNode* node);
 	void Update(float dt);
 	void Clear();
 	void ListNodes(SceneBatch& batch);
+	// Must be called after ListNodes collected activeLights
 	void GatherLights(SceneBatch& batch, SceneNode* node);
 	Vec4 GetAmbientColor() const;
 	Vec4 GetFogColor() const { return fogColor; }
@@ -30,7 +31,7 @@ struct Scene
 	Vec4 GetLightColor() const { return lightColor; }
 	Vec4 GetLightDir() const { return Vec4(lightDir, 1); }
 
-	vector<SceneNode*> nodes;
+	vector<SceneNode*> nodes; // don't modify directly, use Add/Remove/Detach
 	vector<ParticleEmitter*> particleEmitters;
 	vector<Light*> lights, activeLights;
 	Terrain* terrain;
@@ -40,4 +41,17 @@ struct Scene
 	Vec2 fogRange;
 	Color clearColor, ambientColor, lightColor, fogColor;
 	bool useLightDir;
+
+private:
+	void AddNode(SceneBatch& batch, SceneNode* node);
+	void UpdateEmitter(uint index);
+
+	AabbTree tree;
+	LightGrid lightGrid;
+	vector<bool> lightVisible;
+	vector<uint> nearLights;
+	vector<byte> emitterFinished;
+	float updateDt;
+	SphereBatch spheres;
+	vector<SceneNode*> partialNodes;
 };
@@ -18,8 +18,11 @@ public:
 
 	Scene* GetScene() { return scene; }
 	SceneBatch& GetBatch();
+	MeshInstance::Lod GetAnimationLod(float distSq) const;
 
 	bool useLighting, useFog, useNormalmap, useSpecularmap;
+	float animLodDist[MeshInstance::LOD_MAX - 1]; // distance where next animation lod starts
+	uint animLodRate; // bones of lower animation lods are updated every n frames
 
 private:
 	void DrawSceneNodes(const vector<SceneNode*>& nodes, const vector<SceneNodeGroup>& groups);
@@ -2,6 +2,7 @@
 
 //-----------------------------------------------------------------------------
 #include "MeshInstance.h"
+#include "Terrain.h"
 
 //-----------------------------------------------------------------------------
 struct SceneNode : public ObjectPoolProxy<SceneNode>
@@ -30,14 +31,19 @@ struct SceneNode : public ObjectPoolProxy<SceneNode>
 	float radius, dist;
 	const TexOverride* texOverride;
 	Vec4 tint;
-	Vec3 pos, rot, scale;
+	Vec3 pos, rot, scale; // when node is in scene use SetPos or UpdateMatrix after changing pos (or call Scene::UpdateNode)
 	array<Light*, 3> lights;
+	Scene* scene;
+	int proxy; // in Scene tree
+	uint sceneIndex; // in Scene nodes
 	bool visible, meshInstOwner, addBlend;
 
 	void OnGet();
 	void OnFree();
 	void SetMesh(Mesh* mesh, MeshInstance* meshInst = nullptr);
 	void SetMesh(MeshInstance* meshInst);
+	void SetPos(const Vec3& pos);
+	// Also updates node in scene tree
 	void UpdateMatrix();
 
 private:
@@ -57,7 +63,9 @@ struct SceneBatch
 	vector<SceneNode*> alphaNodes;
 	vector<SceneNodeGroup> nodeGroups;
 	vector<ParticleEmitter*> particleEmitters;
-	vector<uint> terrainParts;
+	vector<TerrainPartLod> terrainParts;
+	vector<MeshInstance*> meshInsts; // animated instances that need bones update
+	array<uint, MeshInstance::LOD_MAX> animLodCounter; // animated instances at each lod (including not updated in this frame)
 	Scene* scene;
 	Camera* camera;
 	bool gatherLights;
@@ -65,6 +73,12 @@ struct SceneBatch
 	void Clear();
 	void Add(SceneNode* node);
 	void Process();
+
+private:
+	void SetupBones();
+	void SetupBonesJob(uint index) { meshInsts[index]->SetupBones(meshInsts[index]->GetLod()); }
+
+	uint id;
 };
 
 //-----------------------------------------------------------------------------
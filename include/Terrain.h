@@ -1,8 +1,17 @@
 #pragma once
 
 //-----------------------------------------------------------------------------
+#include "QuadTree.h"
 #include "VertexDeclaration.h"
 
+//-----------------------------------------------------------------------------
+struct TerrainPartLod
+{
+	uint index;
+	uint lod; // 0 - full detail
+	int edges; // Terrain::Edge flags
+};
+
 //-----------------------------------------------------------------------------
 struct Terrain
 {
@@ -43,8 +52,21 @@ public:
 		Box box;
 	};
 
+	//---------------------------
+	// Sides of part next to part with lower detail
+	enum Edge
+	{
+		EDGE_LEFT = 1 << 0, // -x
+		EDGE_RIGHT = 1 << 1, // +x
+		EDGE_BOTTOM = 1 << 2, // -z
+		EDGE_TOP = 1 << 3 // +z
+	};
+
 	static const int DEFAULT_UV_MOD = 2;
+	static constexpr uint MAX_LODS = 6;
+	static constexpr float DEFAULT_LOD_TOLERANCE = 0.002f;
 	int uvMod;
+	float lodTolerance; // allowed height error per unit of distance from camera when selecting part lod
 
 	//---------------------------
 	Terrain();
@@ -52,9 +74,13 @@ public:
 
 	//---------------------------
 	void Init(const Options& options);
+	// Vertices are shared between tiles so normals are always smooth, parameter is left for compatibility
 	void Build(bool smooth = true);
 	void Rebuild(bool smooth = true);
 	void RebuildUv();
+	// Mark tiles (x in [p1.x, p2.x), z in [p1.y, p2.y)) with changed height, RebuildDirty updates only them
+	void MarkDirty(const Rect& tiles);
+	void RebuildDirty();
 	void Make(bool smooth = true);
 	void SetHeight(float height);
 	void SetBordersHeight(float height);
@@ -68,6 +94,9 @@ public:
 	void SmoothNormals(VTerrain* v);
 	void FillGeometry(vector<Tri>& tris, vector<Vec3>& verts);
 	void FillGeometryPart(vector<Tri>& tris, vector<Vec3>& verts, int px, int pz, const Vec3& offset = Vec3(0, 0, 0)) const;
+	// Fill indices of part mesh at lod (step 2^lod tiles), edges with lower detail neighbour are stitched to it,
+	// vertices are relative to part first vertex, pitch is number of vertices in row
+	static void FillLodIndices(uint tilesPerPart, uint pitch, uint lod, int edges, vector<uint>& indices);
 
 	//---------------------------
 	Part* GetPart(uint idx)
@@ -78,8 +107,18 @@ public:
 	float GetH(float x, float z) const;
 	float GetH(const Vec3& v) const { return GetH(v.x, v.z); }
 	float GetH(const Vec2& v) const { return GetH(v.x, v.y); }
+	// Batch version, calculates 4 points at once
+	void GetH(const Vec2* in, float* out, uint count) const;
 	void SetY(Vec3& v) const { v.y = GetH(v.x, v.z); }
+	// Uses normal map when built
 	void GetAngle(float x, float z, Vec3& angle) const;
+	// Normal of triangle at point or interpolated from normal map when built
+	Vec3 GetNormal(float x, float z) const;
+	void GetNormal(const Vec2* in, Vec3* out, uint count) const;
+	// Precalculate smooth normal for every height map point, updated by Rebuild/RebuildDirty/SmoothNormals
+	void BuildNormalMap();
+	void ClearNormalMap() { normalMap.clear(); normalMap.shrink_to_fit(); }
+	bool HaveNormalMap() const { return !normalMap.empty(); }
 	uint GetPartsCount() const { return nParts2; }
 	DynamicTexture& GetSplatTexture() { return *texSplat; }
 	TexturePtr* GetTextures() { return tex; }
@@ -89,6 +128,8 @@ public:
 	uint GetWidth() const { return width; }
 	uint GetTilesCount() const { return nTiles; }
 	uint GetSplatSize() const { return texSize; }
+	uint GetLodCount() const { return lodCount; }
+	float GetLodError(uint part, uint lod) const { return lodErrors[part * lodCount + lod]; }
 	float GetPartSize() const { return tilesSize / nParts; }
 	float GetTileSize() const { return tileSize; }
 
@@ -98,18 +139,54 @@ public:
 	void SetHeightMap(float* h);
 	bool IsInside(float x, float z) const;
 	bool IsInside(const Vec3& v) const { return IsInside(v.x, v.z); }
-	void ListVisibleParts(vector<uint>& parts, const FrustumPlanes& frustum) const;
+	// List visible parts with lod selected by distance from camera
+	void ListVisibleParts(vector<TerrainPartLod>& parts, const FrustumPlanes& frustum, const Vec3& cameraPos) const;
 
 private:
+	static constexpr int LOD_EDGE_VARIANTS = 16;
+
+	struct LodPattern
+	{
+		uint start, count;
+	};
+
+	enum Corner
+	{
+		CORNER_BOTTOM_LEFT,
+		CORNER_BOTTOM_RIGHT,
+		CORNER_TOP_LEFT,
+		CORNER_TOP_RIGHT
+	};
+
+	void CalculateQuadTreeHeight(QuadNode* node);
+	void CalculatePartBox(uint index);
+	void CalculateLodErrors(uint index);
+	void CalculateTotalBox();
+	void CalculateNormals(VTerrain* v, const Rect& points);
+	// Select lods for parts inside area (in parts grid)
+	void SelectLods(const Vec3& cameraPos, const Rect& area) const;
+	TerrainPartLod GetPartLod(uint index) const;
+	// Get offsets inside tile and tile corner heights for 4 points
+	void GetTiles4(const Vec2* in, XMVECTOR& ox, XMVECTOR& oz, XMVECTOR* corners) const;
+
 	Part* parts;
+	QuadTree quadTree; // over parts grid
+	mutable QuadTree::Nodes visibleNodes;
+	mutable vector<uint> candidateParts, visibleParts;
+	mutable BoxBatch partBoxes;
+	vector<LodPattern> lodPatterns; // [lod * LOD_EDGE_VARIANTS + edges]
+	vector<float> lodErrors; // [part * lodCount + lod]
+	vector<Vec3> normalMap;
+	mutable vector<byte> partLods;
 	float* h;
 	float tileSize; // rozmiar jednego maego kwadraciku terenu
+	float invTileSize;
 	float tilesSize;
 	uint nTiles, nTiles2; // liczba kwadracikw na boku, wszystkich
 	uint nParts, nParts2; // liczba sektorw na boku, wszystkich
 	uint tilesPerPart;
 	uint width, width2; // nTiles+1
-	uint nTris, nVerts, partTris, partVerts, texSize;
+	uint nVerts, texSize, lodCount;
 	Box box;
 	ID3D11Buffer* vb;
 	ID3D11Buffer* vbStaging;
@@ -118,4 +195,7 @@ private:
 	TexturePtr tex[5];
 	Vec3 pos;
 	int state;
+	Rect dirtyTiles;
+	bool smallIndices; // 16 bit indices when all vertices fit
+	bool dirty;
 };
@@ -12,7 +12,7 @@ public:
 	void OnInit() override;
 	void OnRelease() override;
 	void Prepare(Scene* scene, Camera* camera);
-	void Draw(Terrain* terrain, const vector<uint>& parts);
+	void Draw(Terrain* terrain, const vector<TerrainPartLod>& parts);
 
 private:
 	ID3D11DeviceContext* deviceContext;
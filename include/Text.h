@@ -71,15 +71,96 @@ struct CstringEqualComparer
 	}
 };
 
+//-----------------------------------------------------------------------------
+// Type safe argument for Format functions, uses printf syntax but value type is taken from argument
+// (length modifiers like l, ll, I64 are ignored)
+struct FormatArg
+{
+	enum Type
+	{
+		INT,
+		UINT,
+		INT64,
+		UINT64,
+		DOUBLE,
+		CHAR,
+		STRING,
+		POINTER
+	};
+
+	FormatArg(char c) : type(CHAR), i(c) {}
+	FormatArg(int value) : type(INT), i(value) {}
+	FormatArg(uint value) : type(UINT), u(value) {}
+	FormatArg(long value) : type(INT), i(value) {}
+	FormatArg(unsigned long value) : type(UINT), u(value) {}
+	FormatArg(int64 value) : type(INT64), i(value) {}
+	FormatArg(uint64 value) : type(UINT64), u(value) {}
+	FormatArg(double value) : type(DOUBLE), d(value) {}
+	FormatArg(cstring str) : type(STRING), s(str), length(UINT_MAX) {}
+	FormatArg(const string& str) : type(STRING), s(str.c_str()), length(str.length()) {}
+	FormatArg(const LocalString& str) : type(STRING), s(str->c_str()), length(str->length()) {}
+	FormatArg(const Cstring& str) : type(STRING), s(str.s), length(UINT_MAX) {}
+	FormatArg(std::string_view str) : type(STRING), s(str.data()), length(str.length()) {}
+	FormatArg(const void* ptr) : type(POINTER), p(ptr) {}
+	FormatArg(std::nullptr_t) : type(POINTER), p(nullptr) {}
+	template<typename T, typename std::enable_if<std::is_enum<T>::value>::type* = nullptr>
+	FormatArg(T value) : FormatArg((typename std::underlying_type<T>::type)value) {}
+
+	Type type;
+	union
+	{
+		int64 i;
+		uint64 u;
+		double d;
+		cstring s;
+		const void* p;
+	};
+	uint length; // for string, UINT_MAX if null terminated
+};
+
+// Format into string (appended), result isn't truncated
+void FormatArgs(string& str, cstring fmt, const FormatArg* args, uint count);
+// Format into one of thread local strings, returned string is overwritten after FORMAT_STRINGS calls
+cstring FormatArgs(cstring fmt, const FormatArg* args, uint count);
+// Format into buffer, returns length of whole text (result is truncated when buffer is too small)
+uint FormatArgs(char* buf, uint size, cstring fmt, const FormatArg* args, uint count);
+
 //-----------------------------------------------------------------------------
 char* GetFormatString();
-cstring Format(cstring fmt, ...);
+template<typename... Args>
+inline cstring Format(cstring fmt, const Args&... args)
+{
+	const FormatArg list[] = { args..., 0 };
+	return FormatArgs(fmt, list, sizeof...(Args));
+}
 cstring FormatList(cstring fmt, va_list lis);
-void FormatStr(string& str, cstring fmt, ...);
+template<typename... Args>
+inline void FormatStr(string& str, cstring fmt, const Args&... args)
+{
+	const FormatArg list[] = { args..., 0 };
+	str.clear();
+	FormatArgs(str, fmt, list, sizeof...(Args));
+}
+template<typename... Args>
+inline void FormatAppend(string& str, cstring fmt, const Args&... args)
+{
+	const FormatArg list[] = { args..., 0 };
+	FormatArgs(str, fmt, list, sizeof...(Args));
+}
+template<typename... Args>
+inline uint FormatBuf(char* buf, uint size, cstring fmt, const Args&... args)
+{
+	const FormatArg list[] = { args..., 0 };
+	return FormatArgs(buf, size, fmt, list, sizeof...(Args));
+}
 cstring Upper(cstring str);
 vector<string> Split(cstring str, char delimiter = ' ', char quote = '"');
 void SplitText(char* buf, vector<cstring>& lines);
-bool Unescape(const string& strIn, uint pos, uint length, string& strOut);
+bool Unescape(cstring strIn, uint length, string& strOut);
+inline bool Unescape(const string& strIn, uint pos, uint length, string& strOut)
+{
+	return Unescape(strIn.c_str() + pos, length, strOut);
+}
 inline bool Unescape(const string& strIn, string& strOut)
 {
 	return Unescape(strIn, 0u, strIn.length(), strOut);
@@ -0,0 +1,31 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Persistent worker threads used to split work inside single frame, calling thread also takes part in it
+class ThreadPool
+{
+	typedef void* Handle;
+
+public:
+	typedef delegate<void(uint)> Job;
+
+	ThreadPool();
+	~ThreadPool();
+	// Start worker threads (0 - one less then hardware threads)
+	void Init(uint count = 0);
+	void Shutdown();
+	// Call job for every index in [0, count) and wait until all are done (can't be nested)
+	void ParallelFor(uint count, Job job);
+	uint GetThreadCount() const { return (uint)workers.size(); }
+
+private:
+	void Run();
+	void RunJobs();
+
+	vector<thread> workers;
+	Job job;
+	Handle semaphore;
+	std::atomic<uint> next, working;
+	uint count;
+	bool quit;
+};
@@ -37,6 +37,29 @@ namespace tokenizer
 		}
 	};
 
+	// List of keywords matching item, points into tokenizer keyword table
+	struct KeywordList
+	{
+		Keyword* const* ptr;
+		uint count;
+
+		KeywordList() : ptr(nullptr), count(0) {}
+		Keyword* operator [] (uint index) const
+		{
+			assert(index < count);
+			return ptr[index];
+		}
+		Keyword* const* begin() const { return ptr; }
+		Keyword* const* end() const { return ptr + count; }
+		uint size() const { return count; }
+		bool empty() const { return count == 0; }
+		void clear()
+		{
+			ptr = nullptr;
+			count = 0;
+		}
+	};
+
 	struct KeywordGroup
 	{
 		cstring name;
@@ -70,7 +93,7 @@ namespace tokenizer
 		float _float;
 		char _char;
 		uint _uint;
-		vector<Keyword*> keyword;
+		KeywordList keyword;
 	};
 
 	struct Pos
@@ -93,6 +116,7 @@ namespace tokenizer
 
 	public:
 		static const int EMPTY_GROUP = -1;
+		static const uint DEFAULT_WINDOW_SIZE = 64 * 1024;
 
 		class Exception
 		{
@@ -232,9 +256,20 @@ namespace tokenizer
 
 		void FromString(cstring str);
 		void FromString(const string& str);
+		// Parse file from read-only memory mapping
 		bool FromFile(cstring path);
 		bool FromFile(const string& path) { return FromFile(path.c_str()); }
+		// Parse file using sliding window, for very large files
+		bool FromFileStream(cstring path, uint windowSize = DEFAULT_WINDOW_SIZE);
+		// Parse buffer and take ownership of it (for example from Resource::GetBuffer)
+		void FromBuffer(Buffer* buf);
+		// Parse external memory, must be valid while parsing (for example from Resource::GetView)
+		void FromMemory(cstring data, uint size);
+		// Parse file using binary token cache, cache is created when file, keywords or flags changed
+		bool FromCache(cstring path, cstring cachePath);
 		void FromTokenizer(const Tokenizer& t);
+		// Release source (file mapping, buffer), file can't be modified while it's mapped
+		void Close() { FreeSource(); }
 
 		typedef bool(*SkipToFunc)(Tokenizer& t);
 
@@ -270,10 +305,10 @@ namespace tokenizer
 		bool PeekSymbol(char symbol);
 		char PeekChar()
 		{
-			if(IsEof())
+			if(IsEof() || normalSeek.pos >= len)
 				return 0;
 			else
-				return str->at(normalSeek.pos);
+				return data[normalSeek.pos];
 		}
 		void NextChar()
 		{
@@ -353,21 +388,19 @@ namespace tokenizer
 		{
 			formatter.Throw(msg);
 		}
-		template<typename T>
-		__declspec(noreturn) void Throw(cstring msg, T arg, ...) const
+		template<typename... Args>
+		__declspec(noreturn) void Throw(cstring msg, const Args&... args) const
 		{
-			cstring err = FormatList(msg, (va_list)&arg);
-			formatter.Throw(err);
+			formatter.Throw(Format(msg, args...));
 		}
 		__declspec(noreturn) void ThrowAt(uint line, uint charpos, cstring msg) const
 		{
 			formatter.ThrowAt(line, charpos, msg);
 		}
-		template<typename T>
-		__declspec(noreturn) void ThrowAt(uint line, uint charpos, cstring msg, T arg, ...) const
+		template<typename... Args>
+		__declspec(noreturn) void ThrowAt(uint line, uint charpos, cstring msg, const Args&... args) const
 		{
-			cstring err = FormatList(msg, (va_list)&arg);
-			formatter.ThrowAt(line, charpos, err);
+			formatter.ThrowAt(line, charpos, Format(msg, args...));
 		}
 		cstring Expecting(cstring what) const
 		{
@@ -580,7 +613,8 @@ namespace tokenizer
 		}
 		uint GetLine() const { return normalSeek.line + 1; }
 		uint GetCharPos() const { return normalSeek.charpos + 1; }
-		const string& GetInnerString() const { return *str; }
+		// In streaming mode returns only current window
+		std::string_view GetInnerString() const { return std::string_view(data, len); }
 		const Keyword* GetKeyword() const
 		{
 			assert(IsKeyword());
@@ -831,34 +865,80 @@ namespace tokenizer
 		char GetClosingSymbol(char start);
 		bool MoveToClosingSymbol(char start, char end = 0);
 		void ForceMoveToClosingSymbol(char start, char end = 0);
-		void Reset()
-		{
-			normalSeek.token = T_NONE;
-			normalSeek.pos = 0;
-			normalSeek.line = 0;
-			normalSeek.charpos = 0;
-		}
+		void Reset();
 		cstring GetTextRest();
 
 	private:
+		// Keywords with same name, stored in hash table
+		struct KeywordEntry
+		{
+			cstring name;
+			uint len, hash;
+			uint offset, count; // range of enabled keywords in keywordRefs
+			bool firstEnabled;
+		};
+
+		// Token lexed from inputPos (with returnEol = false), saved in cache
+		struct CachedToken
+		{
+			uint inputPos, startPos, pos;
+			uint lines, charpos; // added lines, if 0 charpos is added
+			uint itemOffset, itemLength;
+			int _int;
+			float _float;
+			uint _uint;
+			char _char;
+			byte token;
+			bool checkKeyword;
+		};
+
 		bool DoNext(SeekData& s, bool returnEol);
-		void CheckItemOrKeyword(SeekData& s, const string& item);
+		bool DoNextToken(SeekData& s, bool returnEol);
+		void CheckItemOrKeyword(SeekData& s, std::string_view item);
 		bool ParseNumber(SeekData& s, uint pos2, bool negative);
-		uint FindFirstNotOf(SeekData& s, cstring _str, uint _start);
-		uint FindFirstOf(SeekData& s, cstring _str, uint _start);
+		void SetNumberItem(SeekData& s, uint start, uint end, bool negative);
+		// Find first character that isn't / is in character classes mask, updates line & charpos
+		uint SkipClass(SeekData& s, int mask, uint start);
+		uint FindClass(SeekData& s, int mask, uint start);
+		uint FindChar(SeekData& s, char c, uint start);
 		uint FindFirstOfStr(SeekData& s, cstring _str, uint _start);
 		uint FindEndOfQuote(SeekData& s, uint _start);
 		void CheckSorting();
 		bool CheckMultiKeywords() const;
-
-		const string* str;
+		void BuildKeywordTable();
+		void FreeSource();
+		void FillWindow(SeekData& s, uint end);
+		void SeekWindow(uint offset);
+		bool ReplayToken(SeekData& s);
+		uint CalculateKeywordsCrc();
+		bool LoadCache(cstring cachePath, uint crc, uint keywordsCrc);
+		void BuildCache(cstring cachePath, uint crc, uint keywordsCrc);
+		bool VerifyCache() const;
+
+		const string* str; // string source, null for other sources
+		cstring data; // parsed text (current window in streaming mode), isn't null terminated when mapped
+		uint len;
 		int flags;
 		string filename, tmpId;
 		vector<Keyword> keywords;
 		vector<KeywordGroup> groups;
+		vector<KeywordEntry> keywordTable; // open addressing, size is power of 2
+		vector<Keyword*> keywordRefs;
 		SeekData normalSeek;
 		SeekData* seek;
-		bool needSorting, ownString;
+		FileMapping* mapping;
+		Buffer* buf;
+		// streaming mode
+		FileReader* streamFile;
+		vector<char> window;
+		uint windowOffset, windowSize, keepPos;
+		bool streamEof, needMore;
+		// token cache
+		vector<CachedToken> cache;
+		string cacheStrings;
+		uint cacheIndex;
+		int cacheFlags; // flags used when cache was built, it's skipped when they are changed
+		bool needSorting, needRebuild, ownString;
 		mutable Formatter formatter;
 	};
 }
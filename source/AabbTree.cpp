@@ -0,0 +1,326 @@
+#include "Pch.h"
+#include "AabbTree.h"
+
+//=================================================================================================
+inline Box Merge(const Box& box1, const Box& box2)
+{
+	return Box(min(box1.v1.x, box2.v1.x), min(box1.v1.y, box2.v1.y), min(box1.v1.z, box2.v1.z),
+		max(box1.v2.x, box2.v2.x), max(box1.v2.y, box2.v2.y), max(box1.v2.z, box2.v2.z));
+}
+
+//=================================================================================================
+inline float GetArea(const Box& box)
+{
+	const Vec3 size = box.Size();
+	return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+//=================================================================================================
+inline bool Contains(const Box& outer, const Box& inner)
+{
+	return outer.v1.x <= inner.v1.x && outer.v1.y <= inner.v1.y && outer.v1.z <= inner.v1.z
+		&& outer.v2.x >= inner.v2.x && outer.v2.y >= inner.v2.y && outer.v2.z >= inner.v2.z;
+}
+
+//=================================================================================================
+AabbTree::AabbTree(float margin) : root(INVALID), freeList(INVALID), count(0), margin(margin)
+{
+}
+
+//=================================================================================================
+int AabbTree::Insert(const Box& box, void* data)
+{
+	const int proxy = AllocateNode();
+	Node& node = nodes[proxy];
+	node.box = Box(box, margin);
+	node.data = data;
+	InsertLeaf(proxy);
+	++count;
+	return proxy;
+}
+
+//=================================================================================================
+void AabbTree::Remove(int proxy)
+{
+	assert(IsValid(proxy) && nodes[proxy].IsLeaf());
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	--count;
+}
+
+//=================================================================================================
+bool AabbTree::Move(int proxy, const Box& box)
+{
+	assert(IsValid(proxy) && nodes[proxy].IsLeaf());
+	if(Contains(nodes[proxy].box, box))
+		return false;
+
+	RemoveLeaf(proxy);
+	nodes[proxy].box = Box(box, margin);
+	InsertLeaf(proxy);
+	return true;
+}
+
+//=================================================================================================
+void AabbTree::Clear()
+{
+	nodes.clear();
+	root = INVALID;
+	freeList = INVALID;
+	count = 0;
+}
+
+//=================================================================================================
+int AabbTree::AllocateNode()
+{
+	int index;
+	if(freeList != INVALID)
+	{
+		index = freeList;
+		freeList = nodes[index].next;
+	}
+	else
+	{
+		index = (int)nodes.size();
+		nodes.emplace_back();
+	}
+
+	Node& node = nodes[index];
+	node.data = nullptr;
+	node.parent = INVALID;
+	node.child1 = INVALID;
+	node.child2 = INVALID;
+	node.height = 0;
+	return index;
+}
+
+//=================================================================================================
+void AabbTree::FreeNode(int index)
+{
+	Node& node = nodes[index];
+	node.next = freeList;
+	node.height = -1;
+	freeList = index;
+}
+
+//=================================================================================================
+void AabbTree::InsertLeaf(int leaf)
+{
+	if(root == INVALID)
+	{
+		root = leaf;
+		nodes[root].parent = INVALID;
+		return;
+	}
+
+	// find best sibling by surface area heuristic
+	const Box leafBox = nodes[leaf].box;
+	int index = root;
+	while(!nodes[index].IsLeaf())
+	{
+		const Node& node = nodes[index];
+		const Node& child1 = nodes[node.child1];
+		const Node& child2 = nodes[node.child2];
+		const float area = GetArea(node.box);
+		const float combinedArea = GetArea(Merge(node.box, leafBox));
+
+		// cost of creating new parent for this node and the new leaf
+		const float cost = 2.f * combinedArea;
+		// minimum cost of pushing the leaf further down the tree
+		const float inheritanceCost = 2.f * (combinedArea - area);
+
+		float cost1 = GetArea(Merge(leafBox, child1.box)) + inheritanceCost;
+		if(!child1.IsLeaf())
+			cost1 -= GetArea(child1.box);
+		float cost2 = GetArea(Merge(leafBox, child2.box)) + inheritanceCost;
+		if(!child2.IsLeaf())
+			cost2 -= GetArea(child2.box);
+
+		if(cost < cost1 && cost < cost2)
+			break;
+		index = (cost1 < cost2 ? node.child1 : node.child2);
+	}
+	const int sibling = index;
+
+	// create new parent
+	const int oldParent = nodes[sibling].parent;
+	const int newParent = AllocateNode();
+	Node& parent = nodes[newParent];
+	parent.parent = oldParent;
+	parent.box = Merge(leafBox, nodes[sibling].box);
+	parent.height = nodes[sibling].height + 1;
+	parent.child1 = sibling;
+	parent.child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if(oldParent != INVALID)
+	{
+		if(nodes[oldParent].child1 == sibling)
+			nodes[oldParent].child1 = newParent;
+		else
+			nodes[oldParent].child2 = newParent;
+	}
+	else
+		root = newParent;
+
+	Refit(nodes[leaf].parent);
+}
+
+//=================================================================================================
+void AabbTree::RemoveLeaf(int leaf)
+{
+	if(leaf == root)
+	{
+		root = INVALID;
+		return;
+	}
+
+	const int parent = nodes[leaf].parent;
+	const int grandParent = nodes[parent].parent;
+	const int sibling = (nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1);
+
+	if(grandParent != INVALID)
+	{
+		// connect sibling to grandparent and destroy parent
+		if(nodes[grandParent].child1 == parent)
+			nodes[grandParent].child1 = sibling;
+		else
+			nodes[grandParent].child2 = sibling;
+		nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+		Refit(grandParent);
+	}
+	else
+	{
+		root = sibling;
+		nodes[sibling].parent = INVALID;
+		FreeNode(parent);
+	}
+}
+
+//=================================================================================================
+// Walk up the tree fixing heights and boxes
+void AabbTree::Refit(int index)
+{
+	while(index != INVALID)
+	{
+		index = Balance(index);
+
+		Node& node = nodes[index];
+		const Node& child1 = nodes[node.child1];
+		const Node& child2 = nodes[node.child2];
+		node.height = 1 + max(child1.height, child2.height);
+		node.box = Merge(child1.box, child2.box);
+
+		index = node.parent;
+	}
+}
+
+//=================================================================================================
+// Perform left or right rotation if node A is imbalanced, return new subtree root
+int AabbTree::Balance(int iA)
+{
+	Node& A = nodes[iA];
+	if(A.IsLeaf() || A.height < 2)
+		return iA;
+
+	const int iB = A.child1;
+	const int iC = A.child2;
+	Node& B = nodes[iB];
+	Node& C = nodes[iC];
+	const int balance = C.height - B.height;
+
+	// rotate C up
+	if(balance > 1)
+	{
+		const int iF = C.child1;
+		const int iG = C.child2;
+		Node& F = nodes[iF];
+		Node& G = nodes[iG];
+
+		// swap A and C
+		C.child1 = iA;
+		C.parent = A.parent;
+		A.parent = iC;
+		if(C.parent != INVALID)
+		{
+			if(nodes[C.parent].child1 == iA)
+				nodes[C.parent].child1 = iC;
+			else
+				nodes[C.parent].child2 = iC;
+		}
+		else
+			root = iC;
+
+		// rotate
+		if(F.height > G.height)
+		{
+			C.child2 = iF;
+			A.child2 = iG;
+			G.parent = iA;
+			A.box = Merge(B.box, G.box);
+			C.box = Merge(A.box, F.box);
+			A.height = 1 + max(B.height, G.height);
+			C.height = 1 + max(A.height, F.height);
+		}
+		else
+		{
+			C.child2 = iG;
+			A.child2 = iF;
+			F.parent = iA;
+			A.box = Merge(B.box, F.box);
+			C.box = Merge(A.box, G.box);
+			A.height = 1 + max(B.height, F.height);
+			C.height = 1 + max(A.height, G.height);
+		}
+		return iC;
+	}
+
+	// rotate B up
+	if(balance < -1)
+	{
+		const int iD = B.child1;
+		const int iE = B.child2;
+		Node& D = nodes[iD];
+		Node& E = nodes[iE];
+
+		// swap A and B
+		B.child1 = iA;
+		B.parent = A.parent;
+		A.parent = iB;
+		if(B.parent != INVALID)
+		{
+			if(nodes[B.parent].child1 == iA)
+				nodes[B.parent].child1 = iB;
+			else
+				nodes[B.parent].child2 = iB;
+		}
+		else
+			root = iB;
+
+		// rotate
+		if(D.height > E.height)
+		{
+			B.child2 = iD;
+			A.child1 = iE;
+			E.parent = iA;
+			A.box = Merge(C.box, E.box);
+			B.box = Merge(A.box, D.box);
+			A.height = 1 + max(C.height, E.height);
+			B.height = 1 + max(A.height, D.height);
+		}
+		else
+		{
+			B.child2 = iE;
+			A.child1 = iD;
+			D.parent = iA;
+			A.box = Merge(C.box, D.box);
+			B.box = Merge(A.box, E.box);
+			A.height = 1 + max(C.height, D.height);
+			B.height = 1 + max(A.height, E.height);
+		}
+		return iB;
+	}
+
+	return iA;
+}
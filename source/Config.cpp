@@ -305,9 +305,11 @@ Config::Result Config::Load(cstring defaultFilename)
 	catch(const Tokenizer::Exception& e)
 	{
 		error = e.ToString();
+		t.Close();
 		return PARSE_ERROR;
 	}
 
+	t.Close();
 	changes = false;
 	return OK;
 }
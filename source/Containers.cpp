@@ -29,7 +29,10 @@ ObjectPoolLeakManager::~ObjectPoolLeakManager()
 {
 	if(!callStacks.empty())
 	{
-		OutputDebugString(Format("!!!!!!!!!!!!!!!!!!!!!!!!!!\nObjectPool leaks detected (%u):\n", callStacks.size()));
+		// thread local format strings are already destroyed here, use local buffer
+		char buf[1024];
+		FormatBuf(buf, sizeof(buf), "!!!!!!!!!!!!!!!!!!!!!!!!!!\nObjectPool leaks detected (%u):\n", callStacks.size());
+		OutputDebugString(buf);
 
 		HANDLE handle = GetCurrentProcess();
 		SymInitialize(handle, nullptr, true);
@@ -43,14 +46,16 @@ ObjectPoolLeakManager::~ObjectPoolLeakManager()
 		uint index = 0;
 		for(auto& pcs : callStacks)
 		{
-			OutputDebugString(Format("[%u] Address: %p Call stack:\n", index, pcs.first));
+			FormatBuf(buf, sizeof(buf), "[%u] Address: %p Call stack:\n", index, pcs.first);
+			OutputDebugString(buf);
 			CallStackEntry& cs = *pcs.second;
 			for(uint i = 0; i < CallStackEntry::MAX_FRAMES; ++i)
 			{
 				SymFromAddr(handle, (DWORD64)(uint)cs.frames[i], &displacement, &symbol);
 				DWORD disp;
 				SymGetLineFromAddr64(handle, (DWORD64)(uint)cs.frames[i], &disp, &line);
-				OutputDebugString(Format("\t%s (%d): %s\n", line.FileName, line.LineNumber, symbol.Name));
+				FormatBuf(buf, sizeof(buf), "\t%s (%d): %s\n", line.FileName, line.LineNumber, symbol.Name);
+				OutputDebugString(buf);
 				if(cs.frames[i] == nullptr)
 					break;
 			}
@@ -61,33 +66,36 @@ ObjectPoolLeakManager::~ObjectPoolLeakManager()
 	}
 
 	DeleteElements(callStackPool);
+	cs.Free();
 }
 
 void ObjectPoolLeakManager::Register(void* ptr)
 {
 	assert(ptr && ptr != (void*)0xCDCDCDCD);
+	StartCriticalSection section(cs);
 	assert(callStacks.find(ptr) == callStacks.end());
 
-	CallStackEntry* cs;
+	CallStackEntry* entry;
 	if(callStackPool.empty())
-		cs = new CallStackEntry;
+		entry = new CallStackEntry;
 	else
 	{
-		cs = callStackPool.back();
+		entry = callStackPool.back();
 		callStackPool.pop_back();
 	}
 
-	memset(cs, 0, sizeof(CallStackEntry));
+	memset(entry, 0, sizeof(CallStackEntry));
 
-	RtlCaptureStackBackTrace(1, CallStackEntry::MAX_FRAMES, cs->frames, nullptr);
+	RtlCaptureStackBackTrace(1, CallStackEntry::MAX_FRAMES, entry->frames, nullptr);
 
-	callStacks[ptr] = cs;
+	callStacks[ptr] = entry;
 }
 
 void ObjectPoolLeakManager::Unregister(void* ptr)
 {
 	assert(ptr && ptr != (void*)0xCDCDCDCD);
 
+	StartCriticalSection section(cs);
 	auto it = callStacks.find(ptr);
 	assert(it != callStacks.end());
 	callStackPool.push_back(it->second);
@@ -136,7 +144,12 @@ Buffer* Buffer::Decompress(uint realSize)
 	Buffer* buf = Buffer::Get();
 	buf->Resize(realSize);
 	uLong size = realSize;
-	uncompress(static_cast<Bytef*>(buf->Data()), &size, static_cast<const Bytef*>(Data()), Size());
+	const int result = uncompress(static_cast<Bytef*>(buf->Data()), &size, static_cast<const Bytef*>(Data()), Size());
 	Free();
+	if(result != Z_OK || size != realSize)
+	{
+		buf->Free();
+		return nullptr;
+	}
 	return buf;
 }
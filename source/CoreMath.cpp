@@ -573,6 +573,93 @@ bool FrustumPlanes::SphereInFrustum(const Vec3& sphereCenter, float sphereRadius
 	return true;
 }
 
+void FrustumPlanes::SpheresToFrustum(const float* x, const float* y, const float* z, const float* radius, uint count, uint* result) const
+{
+	assert(result || count == 0);
+	if(count == 0)
+		return;
+	memset(result, 0, sizeof(uint) * ((count + 31) / 32));
+
+	__m128 px[6], py[6], pz[6], pw[6];
+	for(int i = 0; i < 6; ++i)
+	{
+		px[i] = _mm_set1_ps(planes[i].x);
+		py[i] = _mm_set1_ps(planes[i].y);
+		pz[i] = _mm_set1_ps(planes[i].z);
+		pw[i] = _mm_set1_ps(planes[i].w);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const uint count4 = count & ~3u;
+	uint index = 0;
+	for(; index < count4; index += 4)
+	{
+		const __m128 vx = _mm_loadu_ps(x + index);
+		const __m128 vy = _mm_loadu_ps(y + index);
+		const __m128 vz = _mm_loadu_ps(z + index);
+		const __m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(radius + index));
+		__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for(int i = 0; i < 6; ++i)
+		{
+			const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[i], vx), _mm_mul_ps(py[i], vy)),
+				_mm_add_ps(_mm_mul_ps(pz[i], vz), pw[i]));
+			visible = _mm_and_ps(visible, _mm_cmpgt_ps(dot, negRadius));
+		}
+		result[index / 32] |= (uint)_mm_movemask_ps(visible) << (index % 32);
+	}
+
+	for(; index < count; ++index)
+	{
+		if(SphereToFrustum(Vec3(x[index], y[index], z[index]), radius[index]))
+			result[index / 32] |= 1u << (index % 32);
+	}
+}
+
+void FrustumPlanes::BoxesToFrustum(const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY,
+	const float* maxZ, uint count, uint* result) const
+{
+	assert(result || count == 0);
+	if(count == 0)
+		return;
+	memset(result, 0, sizeof(uint) * ((count + 31) / 32));
+
+	// for each plane test only corner that is furthest along plane normal
+	const float* cornerX[6], *cornerY[6], *cornerZ[6];
+	__m128 px[6], py[6], pz[6], pw[6];
+	for(int i = 0; i < 6; ++i)
+	{
+		const Plane& plane = planes[i];
+		cornerX[i] = plane.x <= 0 ? minX : maxX;
+		cornerY[i] = plane.y <= 0 ? minY : maxY;
+		cornerZ[i] = plane.z <= 0 ? minZ : maxZ;
+		px[i] = _mm_set1_ps(plane.x);
+		py[i] = _mm_set1_ps(plane.y);
+		pz[i] = _mm_set1_ps(plane.z);
+		pw[i] = _mm_set1_ps(plane.w);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const uint count4 = count & ~3u;
+	uint index = 0;
+	for(; index < count4; index += 4)
+	{
+		__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for(int i = 0; i < 6; ++i)
+		{
+			const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[i], _mm_loadu_ps(cornerX[i] + index)), _mm_mul_ps(py[i], _mm_loadu_ps(cornerY[i] + index))),
+				_mm_add_ps(_mm_mul_ps(pz[i], _mm_loadu_ps(cornerZ[i] + index)), pw[i]));
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(dot, zero));
+		}
+		result[index / 32] |= (uint)_mm_movemask_ps(visible) << (index % 32);
+	}
+
+	for(; index < count; ++index)
+	{
+		if(BoxToFrustum(Box(minX[index], minY[index], minZ[index], maxX[index], maxY[index], maxZ[index])))
+			result[index / 32] |= 1u << (index % 32);
+	}
+}
+
 bool RayToPlane(const Vec3& rayPos, const Vec3& rayDir, const Plane& plane, float* outT)
 {
 	float VD = plane.x * rayDir.x + plane.y * rayDir.y + plane.z * rayDir.z;
@@ -1258,6 +1345,23 @@ uint Hash(const void* ptr, uint size)
 	return result;
 }
 
+uint HashNoCase(cstring str)
+{
+	uint hash = 0x811c9dc5;
+	const uint prime = 0x1000193;
+
+	while(byte value = *str++)
+	{
+		if(value >= 'A' && value <= 'Z')
+			value += 'a' - 'A';
+		hash = hash ^ value;
+		hash *= prime;
+	}
+
+	assert(hash != 0u);
+	return hash;
+}
+
 cstring Guid::ToString() const
 {
 	return Format("%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
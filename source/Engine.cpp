@@ -9,6 +9,7 @@
 #include "Render.h"
 #include "ResourceManager.h"
 #include "SceneManager.h"
+#include "ThreadPool.h"
 #include "SoundManager.h"
 #include "WindowsIncludes.h"
 
@@ -33,6 +34,7 @@ clientSize(wndSize)
 	app::resMgr = new ResourceManager;
 	app::sceneMgr = new SceneManager;
 	app::soundMgr = new SoundManager;
+	app::threadPool = new ThreadPool;
 }
 
 //=================================================================================================
@@ -142,6 +144,7 @@ void Engine::Cleanup()
 	delete app::gui;
 	delete app::sceneMgr;
 	delete app::soundMgr;
+	delete app::threadPool;
 }
 
 //=================================================================================================
@@ -220,6 +223,9 @@ void Engine::DoTick(bool updateGame)
 	// update keyboard shortcuts info
 	app::input->UpdateShortcuts();
 
+	// integrate resources loaded in background
+	app::resMgr->UpdateAsync();
+
 	// update game
 	if(updateGame)
 		app::app->OnUpdate(dt);
@@ -600,6 +606,7 @@ void Engine::Init()
 	app::resMgr->Init();
 	app::gui->Init();
 	app::sceneMgr->Init();
+	app::threadPool->Init();
 	initialized = true;
 }
 
@@ -5,8 +5,8 @@
 #include "WindowsIncludes.h"
 
 //-----------------------------------------------------------------------------
-static DWORD tmp;
-string StreamReader::buf;
+static thread_local DWORD tmp;
+thread_local string StreamReader::buf;
 char BUF[256];
 
 
@@ -85,6 +85,14 @@ void FileReader::Read(void* ptr, uint size)
 	ok = (size == tmp);
 }
 
+bool FileReader::ReadAt(uint offset, void* ptr, uint size) const
+{
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = offset;
+	DWORD bytesRead;
+	return ReadFile(file, ptr, size, &bytesRead, &overlapped) != FALSE && bytesRead == size;
+}
+
 void FileReader::ReadToString(string& s)
 {
 	DWORD size = GetFileSize(file, nullptr);
@@ -150,21 +158,142 @@ bool FileReader::SetPos(uint pos)
 
 
 //-----------------------------------------------------------------------------
-MemoryReader::MemoryReader(BufferHandle& bufHandle) : buf(*bufHandle.Pin())
+BufferedFileReader::BufferedFileReader(uint blockSize) : blockSize(blockSize), blockOffset(0), blockLength(0), pos(0), filePos(0)
 {
-	ok = true;
+	assert(blockSize > 0);
+	block = Buffer::Get();
+	block->Resize(blockSize);
+}
+
+BufferedFileReader::BufferedFileReader(Cstring filename, uint blockSize) : BufferedFileReader(blockSize)
+{
+	Open(filename);
+}
+
+BufferedFileReader::~BufferedFileReader()
+{
+	block->Free();
+}
+
+bool BufferedFileReader::Open(Cstring filename)
+{
+	file.Close();
+	ok = file.Open(filename);
+	blockOffset = 0;
+	blockLength = 0;
 	pos = 0;
+	filePos = 0;
+	return ok;
 }
 
-MemoryReader::MemoryReader(Buffer* buf) : buf(*buf)
+void BufferedFileReader::Close()
+{
+	file.Close();
+	ok = false;
+	blockLength = 0;
+}
+
+void BufferedFileReader::Read(void* ptr, uint size)
+{
+	uint end;
+	if(!ok || !CheckedAdd(pos, size, end) || end > GetSize())
+	{
+		ok = false;
+		return;
+	}
+
+	byte* dst = static_cast<byte*>(ptr);
+	while(size > 0)
+	{
+		if(pos >= blockOffset && pos < blockOffset + blockLength)
+		{
+			// copy what is already in block
+			uint count = min(size, blockOffset + blockLength - pos);
+			memcpy(dst, block->At(pos - blockOffset), count);
+			dst += count;
+			pos += count;
+			size -= count;
+		}
+		else if(size >= blockSize)
+		{
+			// big read, skip block and read directly to destination
+			if(pos != filePos && !file.SetPos(pos))
+			{
+				ok = false;
+				return;
+			}
+			file.Read(dst, size);
+			if(!file)
+			{
+				ok = false;
+				return;
+			}
+			pos += size;
+			filePos = pos;
+			return;
+		}
+		else if(!FillBlock(pos))
+		{
+			ok = false;
+			return;
+		}
+	}
+}
+
+void BufferedFileReader::Skip(uint size)
+{
+	uint end;
+	if(!ok || !CheckedAdd(pos, size, end) || end > GetSize())
+		ok = false;
+	else
+		pos = end;
+}
+
+bool BufferedFileReader::SetPos(uint pos)
+{
+	if(!ok || pos > GetSize())
+		ok = false;
+	else
+		this->pos = pos;
+	return ok;
+}
+
+bool BufferedFileReader::FillBlock(uint offset)
+{
+	if(offset != filePos && !file.SetPos(offset))
+		return false;
+	blockOffset = offset;
+	blockLength = min(blockSize, GetSize() - offset);
+	file.Read(block->Data(), blockLength);
+	filePos = offset + blockLength;
+	if(!file)
+	{
+		blockLength = 0;
+		return false;
+	}
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+MemoryReader::MemoryReader(BufferHandle& bufHandle) : MemoryReader(bufHandle.Pin())
+{
+}
+
+MemoryReader::MemoryReader(Buffer* buf) : buf(buf), data(static_cast<const byte*>(buf->Data())), size(buf->Size()), pos(0)
+{
+	ok = true;
+}
+
+MemoryReader::MemoryReader(const void* data, uint size) : buf(nullptr), data(static_cast<const byte*>(data)), size(size), pos(0)
 {
 	ok = true;
-	pos = 0;
 }
 
 MemoryReader::~MemoryReader()
 {
-	buf.Free();
+	if(buf)
+		buf->Free();
 }
 
 void MemoryReader::Read(void* ptr, uint size)
@@ -173,7 +302,7 @@ void MemoryReader::Read(void* ptr, uint size)
 		ok = false;
 	else
 	{
-		memcpy(ptr, (byte*)buf.Data() + pos, size);
+		memcpy(ptr, data + pos, size);
 		pos += size;
 	}
 }
@@ -196,6 +325,62 @@ bool MemoryReader::SetPos(uint pos)
 }
 
 
+//-----------------------------------------------------------------------------
+FileMapping::~FileMapping()
+{
+	Close();
+}
+
+bool FileMapping::Open(Cstring filename)
+{
+	Close();
+
+	HANDLE file = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+
+	size = GetFileSize(file, nullptr);
+	if(size == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// mapping keeps reference to file, handle can be closed right away
+	mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if(!mapping)
+	{
+		size = 0;
+		return false;
+	}
+
+	data = static_cast<const byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if(!data)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void FileMapping::Close()
+{
+	if(data)
+	{
+		UnmapViewOfFile(data);
+		data = nullptr;
+	}
+	if(mapping)
+	{
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+	size = 0;
+}
+
+
 //-----------------------------------------------------------------------------
 FileWriter::~FileWriter()
 {
@@ -573,3 +758,17 @@ Buffer* io::TryCompress(byte* data, uint size)
 	buf->Free();
 	return nullptr;
 }
+
+//=================================================================================================
+Buffer* io::Decompress(const byte* data, uint size, uint realSize)
+{
+	Buffer* buf = Buffer::Get();
+	buf->Resize(realSize);
+	uLong outSize = realSize;
+	if(uncompress(static_cast<Bytef*>(buf->Data()), &outSize, data, size) != Z_OK || outSize != realSize)
+	{
+		buf->Free();
+		return nullptr;
+	}
+	return buf;
+}
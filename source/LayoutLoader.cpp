@@ -113,6 +113,7 @@ Layout* LayoutLoader::LoadFromFile(cstring inputPath)
 		layout = nullptr;
 	}
 
+	t.Close();
 	return layout;
 }
 
@@ -0,0 +1,164 @@
+#include "Pch.h"
+#include "LightGrid.h"
+
+#include "Light.h"
+
+//=================================================================================================
+LightGrid::LightGrid(float cellSize)
+{
+	SetCellSize(cellSize);
+}
+
+//=================================================================================================
+void LightGrid::SetCellSize(float cellSize)
+{
+	assert(cellSize > 0.f);
+	this->cellSize = cellSize;
+	invCellSize = 1.f / cellSize;
+	Clear();
+}
+
+//=================================================================================================
+void LightGrid::Update(const vector<Light*>& lights)
+{
+	const uint count = (uint)lights.size();
+	for(uint i = count, size = (uint)entries.size(); i < size; ++i)
+		Remove(i);
+	const uint oldCount = min(count, (uint)entries.size());
+	entries.resize(count);
+
+	for(uint i = 0; i < count; ++i)
+	{
+		Light* light = lights[i];
+		Entry& e = entries[i];
+		if(i < oldCount)
+		{
+			if(e.light == light && e.pos == light->pos && e.range == light->range)
+				continue;
+			Remove(i);
+		}
+		e.light = light;
+		e.pos = light->pos;
+		e.range = light->range;
+		Insert(i);
+	}
+}
+
+//=================================================================================================
+void LightGrid::Clear()
+{
+	cells.clear();
+	entries.clear();
+	globalLights.clear();
+}
+
+//=================================================================================================
+void LightGrid::Query(const Vec3& pos, float radius, vector<uint>& result) const
+{
+	result.clear();
+
+	int cellMin[3], cellMax[3];
+	GetCells(pos, radius, cellMin, cellMax);
+	if(GetCellCount(cellMin, cellMax) > MAX_CELLS)
+	{
+		// huge object, cheaper to return everything
+		for(uint i = 0, count = (uint)entries.size(); i < count; ++i)
+			result.push_back(i);
+		return;
+	}
+
+	result.insert(result.end(), globalLights.begin(), globalLights.end());
+	for(int x = cellMin[0]; x <= cellMax[0]; ++x)
+	{
+		for(int y = cellMin[1]; y <= cellMax[1]; ++y)
+		{
+			for(int z = cellMin[2]; z <= cellMax[2]; ++z)
+			{
+				auto it = cells.find(GetKey(x, y, z));
+				if(it != cells.end())
+					result.insert(result.end(), it->second.begin(), it->second.end());
+			}
+		}
+	}
+
+	// light can be in multiple cells, keep original order so results don't depend on grid
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+//=================================================================================================
+void LightGrid::GetCells(const Vec3& pos, float radius, int* cellMin, int* cellMax) const
+{
+	const float p[3] = { pos.x, pos.y, pos.z };
+	for(int i = 0; i < 3; ++i)
+	{
+		cellMin[i] = (int)floor((p[i] - radius) * invCellSize);
+		cellMax[i] = (int)floor((p[i] + radius) * invCellSize);
+	}
+}
+
+//=================================================================================================
+int LightGrid::GetCellCount(const int* cellMin, const int* cellMax)
+{
+	int64 count = 1;
+	for(int i = 0; i < 3; ++i)
+	{
+		count *= (int64)(cellMax[i] - cellMin[i] + 1);
+		if(count > MAX_CELLS)
+			return MAX_CELLS + 1;
+	}
+	return (int)count;
+}
+
+//=================================================================================================
+uint64 LightGrid::GetKey(int x, int y, int z)
+{
+	return ((uint64)(x & 0x1FFFFF) << 42) | ((uint64)(y & 0x1FFFFF) << 21) | (uint64)(z & 0x1FFFFF);
+}
+
+//=================================================================================================
+void LightGrid::Insert(uint index)
+{
+	Entry& e = entries[index];
+	GetCells(e.pos, e.range, e.cellMin, e.cellMax);
+	e.global = GetCellCount(e.cellMin, e.cellMax) > MAX_CELLS;
+	if(e.global)
+	{
+		globalLights.push_back(index);
+		return;
+	}
+
+	for(int x = e.cellMin[0]; x <= e.cellMax[0]; ++x)
+	{
+		for(int y = e.cellMin[1]; y <= e.cellMax[1]; ++y)
+		{
+			for(int z = e.cellMin[2]; z <= e.cellMax[2]; ++z)
+				cells[GetKey(x, y, z)].push_back(index);
+		}
+	}
+}
+
+//=================================================================================================
+void LightGrid::Remove(uint index)
+{
+	Entry& e = entries[index];
+	if(e.global)
+	{
+		RemoveElement(globalLights, index);
+		return;
+	}
+
+	for(int x = e.cellMin[0]; x <= e.cellMax[0]; ++x)
+	{
+		for(int y = e.cellMin[1]; y <= e.cellMax[1]; ++y)
+		{
+			for(int z = e.cellMin[2]; z <= e.cellMax[2]; ++z)
+			{
+				auto it = cells.find(GetKey(x, y, z));
+				RemoveElement(it->second, index);
+				if(it->second.empty())
+					cells.erase(it);
+			}
+		}
+	}
+}
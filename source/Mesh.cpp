@@ -38,65 +38,31 @@ void Mesh::Load(StreamReader& stream, ID3D11Device* device)
 {
 	assert(device);
 
+	Buffer* data = LoadData(stream);
+	CreateBuffers(data, device);
+}
+
+//=================================================================================================
+// Read mesh without creating device objects (used textures are only found, not loaded), can be
+// called from loading thread. Returned buffer contains vertices & indices for CreateBuffers.
+//=================================================================================================
+Buffer* Mesh::LoadData(StreamReader& stream)
+{
 	LoadHeader(stream);
 	SetVertexSizeDecl();
 
-	// ------ vertices
+	// ------ vertices & triangles
 	// ensure size
-	uint size = vertexSize * head.nVerts;
+	const uint vertsSize = vertexSize * head.nVerts;
+	const uint indicesSize = sizeof(word) * head.nTris * 3;
+	uint size = vertsSize + indicesSize;
 	if(!stream.Ensure(size))
-		throw "Failed to read vertex buffer.";
+		throw "Failed to read vertex & index buffer.";
 
 	// read
-	vector<byte>* buf = BufPool.Get();
-	buf->resize(size);
-	stream.Read(buf->data(), size);
-
-	// create vertex buffer
-	D3D11_BUFFER_DESC desc;
-	desc.Usage = D3D11_USAGE_DEFAULT;
-	desc.ByteWidth = size;
-	desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	desc.CPUAccessFlags = 0;
-	desc.MiscFlags = 0;
-	desc.StructureByteStride = 0;
-
-	D3D11_SUBRESOURCE_DATA data = {};
-	data.pSysMem = buf->data();
-
-	HRESULT result = device->CreateBuffer(&desc, &data, &vb);
-	if(FAILED(result))
-	{
-		BufPool.Free(buf);
-		throw Format("Failed to create vertex buffer (%u).", result);
-	}
-	SetDebugName(vb, Format("VB:%s", path.c_str()));
-
-	// ----- triangles
-	// ensure size
-	size = sizeof(word) * head.nTris * 3;
-	if(!stream.Ensure(size))
-		throw "Failed to read index buffer.";
-
-	// read
-	buf->resize(size);
-	stream.Read(buf->data(), size);
-
-	// create index buffer
-	desc.Usage = D3D11_USAGE_DEFAULT;
-	desc.ByteWidth = size;
-	desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	desc.CPUAccessFlags = 0;
-	desc.MiscFlags = 0;
-	desc.StructureByteStride = 0;
-
-	data.pSysMem = buf->data();
-
-	result = device->CreateBuffer(&desc, &data, &ib);
-	BufPool.Free(buf);
-	if(FAILED(result))
-		throw Format("Failed to create index buffer (%u).", result);
-	SetDebugName(ib, Format("IB:%s", path.c_str()));
+	BufferHandle buf(Buffer::Get());
+	buf->Resize(size);
+	stream.Read(buf->Data(), size);
 
 	// ----- submeshes
 	size = Submesh::MIN_SIZE * head.nSubs;
@@ -115,7 +81,7 @@ void Mesh::Load(StreamReader& stream, ID3D11Device* device)
 		stream.Read(sub.name);
 		const string& texName = stream.ReadString1();
 		if(!texName.empty())
-			sub.tex = app::resMgr->LoadInstant<Texture>(texName);
+			sub.tex = app::resMgr->Get<Texture>(texName);
 		else
 			sub.tex = nullptr;
 
@@ -131,7 +97,7 @@ void Mesh::Load(StreamReader& stream, ID3D11Device* device)
 			if(!texName.empty())
 			{
 				head.flags |= F_NORMAL_MAP;
-				sub.texNormal = app::resMgr->LoadInstant<Texture>(texName);
+				sub.texNormal = app::resMgr->Get<Texture>(texName);
 				stream.Read(sub.normalFactor);
 			}
 			else
@@ -145,7 +111,7 @@ void Mesh::Load(StreamReader& stream, ID3D11Device* device)
 		if(!texNameSpecular.empty())
 		{
 			head.flags |= F_SPECULAR_MAP;
-			sub.texSpecular = app::resMgr->LoadInstant<Texture>(texNameSpecular);
+			sub.texSpecular = app::resMgr->Get<Texture>(texNameSpecular);
 			stream.Read(sub.specularFactor);
 			stream.Read(sub.specularColorFactor);
 		}
@@ -244,6 +210,7 @@ void Mesh::Load(StreamReader& stream, ID3D11Device* device)
 					}
 				}
 			}
+			anim.BuildPoseData();
 		}
 
 		// add zero bone to count
@@ -265,6 +232,64 @@ void Mesh::Load(StreamReader& stream, ID3D11Device* device)
 		splits.resize(head.nSubs);
 		stream.Read(splits.data(), size);
 	}
+
+	return buf.Pin();
+}
+
+//=================================================================================================
+// Create vertex & index buffer from data returned by LoadData and load textures (takes ownership of data)
+//=================================================================================================
+void Mesh::CreateBuffers(Buffer* data, ID3D11Device* device)
+{
+	assert(data && device);
+
+	BufferHandle buf(data);
+	const uint vertsSize = vertexSize * head.nVerts;
+	const uint indicesSize = sizeof(word) * head.nTris * 3;
+	assert(buf->Size() == vertsSize + indicesSize);
+
+	// create vertex buffer
+	D3D11_BUFFER_DESC desc;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = vertsSize;
+	desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
+
+	D3D11_SUBRESOURCE_DATA subData = {};
+	subData.pSysMem = buf->Data();
+
+	HRESULT result = device->CreateBuffer(&desc, &subData, &vb);
+	if(FAILED(result))
+		throw Format("Failed to create vertex buffer (%u).", result);
+	SetDebugName(vb, Format("VB:%s", path.c_str()));
+
+	// create index buffer
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = indicesSize;
+	desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
+
+	subData.pSysMem = buf->At(vertsSize);
+
+	result = device->CreateBuffer(&desc, &subData, &ib);
+	if(FAILED(result))
+		throw Format("Failed to create index buffer (%u).", result);
+	SetDebugName(ib, Format("IB:%s", path.c_str()));
+
+	// textures
+	for(Submesh& sub : subs)
+	{
+		if(sub.tex)
+			app::resMgr->LoadInstant(sub.tex);
+		if(sub.texNormal)
+			app::resMgr->LoadInstant(sub.texNormal);
+		if(sub.texSpecular)
+			app::resMgr->LoadInstant(sub.texSpecular);
+	}
 }
 
 //=================================================================================================
@@ -400,6 +425,11 @@ void Mesh::LoadBoneGroups(StreamReader& stream)
 	if(!stream)
 		throw "Failed to read bone groups data.";
 
+	for(word i = 0; i < head.nGroups; ++i)
+		groups[i].leaf = (i != 0);
+	for(word i = 1; i < head.nGroups; ++i)
+		groups[groups[i].parent].leaf = false;
+
 	SetupBoneMatrices();
 }
 
@@ -489,30 +519,114 @@ int Mesh::GetAnimationIndex(Animation* anim) const
 //=================================================================================================
 // Zwraca indeks ramki i czy dokadne trafienie
 //=================================================================================================
-int Mesh::Animation::GetFrameIndex(float time, bool& hit)
+int Mesh::Animation::GetFrameIndex(float time, bool& hit) const
+{
+	assert(time >= 0 && time <= length);
+	return CheckHit(FindFrame(time), time, hit);
+}
+
+//=================================================================================================
+int Mesh::Animation::GetFrameIndex(float time, bool& hit, uint& cursor) const
 {
 	assert(time >= 0 && time <= length);
 
-	for(word i = 0; i < nFrames; ++i)
+	// check cached frame & next one (forward playback), then binary search
+	uint index = cursor;
+	if(!InFrame(index, time))
+	{
+		++index;
+		if(!InFrame(index, time))
+			index = FindFrame(time);
+	}
+	cursor = index;
+	return CheckHit(index, time, hit);
+}
+
+//=================================================================================================
+// Return index of last frame that starts before or at time
+//=================================================================================================
+uint Mesh::Animation::FindFrame(float time) const
+{
+	auto it = std::upper_bound(frames.begin(), frames.end(), time, [](float t, const Keyframe& frame) { return t < frame.time; });
+	assert(it != frames.begin() && "Czas przed pierwsz klatk!");
+	return it == frames.begin() ? 0u : uint(it - frames.begin() - 1);
+}
+
+//=================================================================================================
+int Mesh::Animation::CheckHit(uint index, float time, bool& hit) const
+{
+	if(index + 1u < nFrames && Equal(time, frames[index + 1].time))
+	{
+		hit = true;
+		return index + 1;
+	}
+	// last frame can't be interpolated with next one
+	hit = (Equal(time, frames[index].time) || index + 1u == nFrames);
+	return index;
+}
+
+//=================================================================================================
+void Mesh::Animation::BuildPoseData()
+{
+	boneCount = frames.empty() ? 0u : frames[0].bones.size();
+	const uint count = nFrames * boneCount;
+	framePos.resize(count);
+	frameRot.resize(count);
+	frameScale.resize(count);
+	uint i = 0;
+	for(const Keyframe& frame : frames)
+	{
+		for(const KeyframeBone& bone : frame.bones)
+		{
+			framePos[i] = bone.pos;
+			frameRot[i] = bone.rot;
+			frameScale[i] = bone.scale;
+			++i;
+		}
+	}
+}
+
+//=================================================================================================
+// Scale * Rotation * Translation * mul, scale & translation are applied directly to rotation rows
+// instead of multiplying matrices (gives same values)
+//=================================================================================================
+inline void ComposeBoneMatrix(Matrix& out, FXMVECTOR scale, FXMVECTOR rot, FXMVECTOR pos, const Matrix& mul)
+{
+	XMMATRIX m = XMMatrixRotationQuaternion(rot);
+	m.r[0] = XMVectorMultiply(m.r[0], XMVectorSplatX(scale));
+	m.r[1] = XMVectorMultiply(m.r[1], XMVectorSplatY(scale));
+	m.r[2] = XMVectorMultiply(m.r[2], XMVectorSplatZ(scale));
+	m.r[3] = XMVectorSelect(g_XMIdentityR3, pos, g_XMSelect1110);
+	XMStoreFloat4x4(&out, XMMatrixMultiply(m, XMLoadFloat4x4(&mul)));
+}
+
+//=================================================================================================
+void Mesh::Animation::EvaluatePose(Matrix* out, const vector<byte>& bones, const Bone* meshBones, uint index, float t, bool hit) const
+{
+	assert(out && meshBones && index < nFrames);
+
+	const uint offset = index * boneCount;
+	if(hit)
 	{
-		if(Equal(time, frames[i].time))
+		for(byte b : bones)
 		{
-			// rwne trafienie w klatk
-			hit = true;
-			return i;
+			const uint i = offset + b - 1;
+			ComposeBoneMatrix(out[b], XMLoadFloat3(&frameScale[i]), XMLoadFloat4(&frameRot[i]), XMLoadFloat3(&framePos[i]), meshBones[b].mat);
 		}
-		else if(time < frames[i].time)
+	}
+	else
+	{
+		assert(index + 1u < nFrames);
+		for(byte b : bones)
 		{
-			// bdzie potrzebna interpolacja midzy dwoma klatkami
-			assert(i != 0 && "Czas przed pierwsz klatk!");
-			hit = false;
-			return i - 1;
+			const uint i = offset + b - 1;
+			const uint i2 = i + boneCount;
+			const XMVECTOR scale = XMVectorLerp(XMLoadFloat3(&frameScale[i]), XMLoadFloat3(&frameScale[i2]), t);
+			const XMVECTOR rot = XMQuaternionSlerp(XMLoadFloat4(&frameRot[i]), XMLoadFloat4(&frameRot[i2]), t);
+			const XMVECTOR pos = XMVectorLerp(XMLoadFloat3(&framePos[i]), XMLoadFloat3(&framePos[i2]), t);
+			ComposeBoneMatrix(out[b], scale, rot, pos, meshBones[b].mat);
 		}
 	}
-
-	// bd, chyba nie moe tu doj bo by wywalio si na assercie
-	// chyba e w trybie release
-	return 0;
 }
 
 //=================================================================================================
@@ -531,10 +645,7 @@ void Mesh::KeyframeBone::Interpolate(Mesh::KeyframeBone& out, const Mesh::Keyfra
 //=================================================================================================
 void Mesh::KeyframeBone::Mix(Matrix& out, const Matrix& mul) const
 {
-	out = Matrix::Scale(scale)
-		* Matrix::Rotation(rot)
-		* Matrix::Translation(pos)
-		* mul;
+	ComposeBoneMatrix(out, XMLoadFloat3(&scale), XMLoadFloat4(&rot), XMLoadFloat3(&pos), mul);
 }
 
 //=================================================================================================
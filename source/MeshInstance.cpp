@@ -11,7 +11,8 @@ constexpr Mesh::KeyframeBone blendbZero(Vec3::Zero, Quat::Identity, Vec3::One);
 typedef vector<byte>::const_iterator BoneIter;
 
 //=================================================================================================
-MeshInstance::MeshInstance(Mesh* mesh) : preload(false), mesh(mesh), needUpdate(true), ptr(nullptr), baseSpeed(1.f), matScale(nullptr)
+MeshInstance::MeshInstance(Mesh* mesh) : preload(false), mesh(mesh), needUpdate(true), ptr(nullptr), baseSpeed(1.f), matScale(nullptr), lod(LOD_FULL),
+lodCounter(0), batchId(0)
 {
 	assert(mesh && mesh->IsLoaded() && mesh->IsAnimated());
 
@@ -180,7 +181,7 @@ void MeshInstance::Update(float dt)
 }
 
 //====================================================================================================
-void MeshInstance::SetupBones()
+void MeshInstance::SetupBones(Lod lod)
 {
 	if(!needUpdate)
 		return;
@@ -198,6 +199,14 @@ void MeshInstance::SetupBones()
 		const vector<byte>& bones = mesh->groups[boneGroup].bones;
 		int animGroup;
 
+		// far away, leaf groups (hands, etc) aren't animated
+		if(lod >= LOD_FAR && mesh->groups[boneGroup].leaf)
+		{
+			for(byte b : bones)
+				boneToParentPoseMat[b] = mesh->bones[b].mat;
+			continue;
+		}
+
 		// ustal z ktr animacj ustala blending
 		animGroup = GetUsableGroup(boneGroup);
 
@@ -230,9 +239,17 @@ void MeshInstance::SetupBones()
 		{
 			const Group& grAnim = groups[animGroup];
 			bool hit;
-			const int index = grAnim.GetFrameIndex(hit);
+			int index = grAnim.GetFrameIndex(hit);
 			const vector<Mesh::Keyframe>& frames = grAnim.anim->frames;
 
+			// far away, use nearest keyframe without interpolation
+			if(lod >= LOD_FAR && !hit)
+			{
+				if(grAnim.time - frames[index].time > frames[index + 1].time - grAnim.time)
+					++index;
+				hit = true;
+			}
+
 			if(grAnim.IsBlending() || grBones.IsBlending())
 			{
 				// jest blending
@@ -269,30 +286,8 @@ void MeshInstance::SetupBones()
 			else
 			{
 				// nie ma blendingu
-				if(hit)
-				{
-					// rwne trafienie w klatk
-					const vector<Mesh::KeyframeBone>& keyf = frames[index].bones;
-					for(BoneIter it = bones.begin(), end = bones.end(); it != end; ++it)
-					{
-						const word b = *it;
-						keyf[b - 1].Mix(boneToParentPoseMat[b], mesh->bones[b].mat);
-					}
-				}
-				else
-				{
-					// trzeba interpolowa
-					const float t = (grAnim.time - frames[index].time) / (frames[index + 1].time - frames[index].time);
-					const vector<Mesh::KeyframeBone>& keyf = frames[index].bones;
-					const vector<Mesh::KeyframeBone>& keyf2 = frames[index + 1].bones;
-
-					for(BoneIter it = bones.begin(), end = bones.end(); it != end; ++it)
-					{
-						const word b = *it;
-						Mesh::KeyframeBone::Interpolate(tmpKeyf, keyf[b - 1], keyf2[b - 1], t);
-						tmpKeyf.Mix(boneToParentPoseMat[b], mesh->bones[b].mat);
-					}
-				}
+				const float t = hit ? 0.f : (grAnim.time - frames[index].time) / (frames[index + 1].time - frames[index].time);
+				grAnim.anim->EvaluatePose(boneToParentPoseMat, bones, mesh->bones.data(), index, t, hit);
 			}
 		}
 	}
@@ -863,6 +858,20 @@ void MeshInstance::SetAnimation(Mesh::Animation* anim, float p)
 	SetupBones();
 }
 
+//=================================================================================================
+bool MeshInstance::UpdateLod(Lod lod, uint rate)
+{
+	assert(lod < LOD_MAX && rate > 0u);
+	this->lod = lod;
+	if(lod == LOD_FULL || lodCounter == 0u)
+	{
+		lodCounter = rate - 1;
+		return true;
+	}
+	--lodCounter;
+	return false;
+}
+
 //=================================================================================================
 void MeshInstance::SetBlendMax(float value, uint group)
 {
@@ -0,0 +1,190 @@
+#include "Pch.h"
+#include "Pak.h"
+
+#include <zlib.h>
+
+//=================================================================================================
+PakEntryReader::PakEntryReader(Pak* pak, uint index) : pak(*pak), entry(pak->files[index]), chunk(nullptr), tmp(nullptr), pos(0),
+currentChunk((uint)-1), direct(false)
+{
+	ok = true;
+	if(pak->IsChunked(entry))
+	{
+		// read chunk table
+		const uint count = Pak::GetChunkCount(entry.size);
+		const uint tableSize = sizeof(uint) * count;
+		chunkSize = Pak::CHUNK_SIZE;
+		dataOffset = entry.offset + tableSize;
+		chunkEnds.resize(count);
+		if(tableSize > entry.compressedSize || !ReadRaw(entry.offset, chunkEnds.data(), tableSize))
+		{
+			ok = false;
+			return;
+		}
+		if(pak->encrypted)
+			io::Crypt((char*)chunkEnds.data(), tableSize, pak->key.c_str(), pak->key.length());
+		// chunks must be in order and inside entry data
+		const uint dataSize = entry.compressedSize - tableSize;
+		uint prevEnd = 0;
+		for(uint end : chunkEnds)
+		{
+			if(end < prevEnd || end > dataSize)
+			{
+				ok = false;
+				return;
+			}
+			prevEnd = end;
+		}
+		if(chunkEnds.back() != dataSize)
+			ok = false;
+	}
+	else if(entry.IsCompressed() || pak->encrypted)
+	{
+		// whole file is single chunk
+		chunkSize = entry.size;
+		dataOffset = entry.offset;
+		chunkEnds.push_back(entry.compressedSize);
+	}
+	else
+	{
+		// plain data, read directly
+		chunkSize = entry.size;
+		dataOffset = entry.offset;
+		direct = true;
+	}
+}
+
+//=================================================================================================
+PakEntryReader::~PakEntryReader()
+{
+	if(chunk)
+		chunk->Free();
+	if(tmp)
+		tmp->Free();
+}
+
+//=================================================================================================
+void PakEntryReader::Read(void* ptr, uint size)
+{
+	uint end;
+	if(!ok || !CheckedAdd(pos, size, end) || end > GetSize())
+	{
+		ok = false;
+		return;
+	}
+
+	if(direct)
+	{
+		ok = ReadRaw(dataOffset + pos, ptr, size);
+		if(ok)
+			pos += size;
+		return;
+	}
+
+	byte* dst = static_cast<byte*>(ptr);
+	while(size > 0)
+	{
+		const uint index = pos / chunkSize;
+		const uint offset = pos % chunkSize;
+		const uint rawSize = GetChunkRawSize(index);
+		const uint count = min(size, rawSize - offset);
+		if(offset == 0 && count == rawSize && index != currentChunk)
+		{
+			// whole chunk requested, decompress directly to destination
+			if(!LoadChunk(index, dst))
+			{
+				ok = false;
+				return;
+			}
+		}
+		else
+		{
+			if(index != currentChunk)
+			{
+				if(!chunk)
+				{
+					chunk = Buffer::Get();
+					chunk->Resize(chunkSize);
+				}
+				if(!LoadChunk(index, static_cast<byte*>(chunk->Data())))
+				{
+					currentChunk = (uint)-1;
+					ok = false;
+					return;
+				}
+				currentChunk = index;
+			}
+			memcpy(dst, chunk->At(offset), count);
+		}
+		dst += count;
+		pos += count;
+		size -= count;
+	}
+}
+
+//=================================================================================================
+void PakEntryReader::Skip(uint size)
+{
+	uint end;
+	if(!ok || !CheckedAdd(pos, size, end) || end > GetSize())
+		ok = false;
+	else
+		pos = end;
+}
+
+//=================================================================================================
+bool PakEntryReader::SetPos(uint pos)
+{
+	if(!ok || pos > GetSize())
+		ok = false;
+	else
+		this->pos = pos;
+	return ok;
+}
+
+//=================================================================================================
+bool PakEntryReader::ReadRaw(uint offset, void* ptr, uint size)
+{
+	if(pak.mapping.IsOpen())
+	{
+		memcpy(ptr, pak.mapping.At(offset), size);
+		return true;
+	}
+	return pak.file.ReadAt(offset, ptr, size);
+}
+
+//=================================================================================================
+bool PakEntryReader::LoadChunk(uint index, byte* dst)
+{
+	const uint begin = (index == 0 ? 0 : chunkEnds[index - 1]);
+	const uint end = chunkEnds[index];
+	const uint rawSize = GetChunkRawSize(index);
+	if(begin > end || end - begin > rawSize)
+		return false;
+	const uint srcSize = end - begin;
+
+	const byte* src;
+	if(pak.mapping.IsOpen() && !pak.encrypted)
+		src = pak.mapping.At(dataOffset + begin);
+	else
+	{
+		if(!tmp)
+			tmp = Buffer::Get();
+		tmp->Resize(srcSize);
+		if(!ReadRaw(dataOffset + begin, tmp->Data(), srcSize))
+			return false;
+		if(pak.encrypted)
+			io::Crypt((char*)tmp->Data(), srcSize, pak.key.c_str(), pak.key.length());
+		src = static_cast<const byte*>(tmp->Data());
+	}
+
+	// chunk that wouldn't get smaller is stored uncompressed
+	if(srcSize == rawSize)
+	{
+		memcpy(dst, src, rawSize);
+		return true;
+	}
+
+	uLong outSize = rawSize;
+	return uncompress(dst, &outSize, src, srcSize) == Z_OK && outSize == rawSize;
+}
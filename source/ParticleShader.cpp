@@ -139,17 +139,15 @@ void ParticleShader::DrawParticles(const vector<ParticleEmitter*>& pes)
 			ResourceLock lock(vb);
 			VParticle* v = lock.Get<VParticle>();
 			int idx = 0;
-			for(const ParticleEmitter::Particle& p : pe.particles)
+			for(int i = 0; i < pe.alive; ++i)
 			{
-				if(!p.exists)
-					continue;
+				const Vec3& pos = pe.particles.pos[i];
+				matViewInv._41 = pos.x;
+				matViewInv._42 = pos.y;
+				matViewInv._43 = pos.z;
+				Matrix m1 = Matrix::Scale(pe.GetScale(i)) * matViewInv;
 
-				matViewInv._41 = p.pos.x;
-				matViewInv._42 = p.pos.y;
-				matViewInv._43 = p.pos.z;
-				Matrix m1 = Matrix::Scale(pe.GetScale(p)) * matViewInv;
-
-				const Vec4 color(1.f, 1.f, 1.f, pe.GetAlpha(p));
+				const Vec4 color(1.f, 1.f, 1.f, pe.GetAlpha(i));
 
 				v[idx].pos = Vec3::Transform(Vec3(-1, -1, 0), m1);
 				v[idx].tex = Vec2(0, 0);
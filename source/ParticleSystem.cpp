@@ -22,12 +22,13 @@ float DropRange(float v, float t)
 //=================================================================================================
 void ParticleEmitter::Init()
 {
-	particles.resize(maxParticles);
+	particles.pos.resize(maxParticles);
+	particles.speed.resize(maxParticles);
+	particles.life.resize(maxParticles);
 	time = 0.f;
 	alive = 0;
 	destroy = false;
-	for(int i = 0; i < maxParticles; ++i)
-		particles[i].exists = false;
+	rng.seed(RandU());
 
 	// calculate radius
 	radius = 0.f;
@@ -65,56 +66,15 @@ void ParticleEmitter::Init()
 }
 
 //=================================================================================================
-bool ParticleEmitter::Update(float dt)
+bool ParticleEmitter::Simulate(float dt)
 {
 	if(emissions == 0 || (life > 0 && (life -= dt) <= 0.f))
 		destroy = true;
 
 	if(destroy && alive == 0)
-	{
-		if(manualDelete == 0)
-			delete this;
-		else
-			manualDelete = 2;
 		return true;
-	}
 
-	// update particles
-	if(gravity)
-	{
-		for(Particle& p : particles)
-		{
-			if(!p.exists)
-				continue;
-
-			if((p.life -= dt) <= 0.f)
-			{
-				p.exists = false;
-				--alive;
-			}
-			else
-			{
-				p.pos += p.speed * dt;
-				p.speed.y -= G * dt;
-			}
-		}
-	}
-	else
-	{
-		for(Particle& p : particles)
-		{
-			if(!p.exists)
-				continue;
-
-			if((p.life -= dt) <= 0.f)
-			{
-				p.exists = false;
-				--alive;
-			}
-			else
-				p.pos += p.speed * dt;
-		}
-	}
+	UpdateParticles(dt);
 
 	// emission
 	if(!destroy && (emissions == -1 || emissions > 0) && ((time += dt) >= emissionInterval))
@@ -123,19 +83,12 @@ bool ParticleEmitter::Update(float dt)
 			--emissions;
 		time -= emissionInterval;
 
-		int count = min(spawn.Random(), maxParticles - alive);
-		vector<Particle>::iterator it2 = particles.begin();
-
-		for(int i = 0; i < count; ++i)
+		int count = min(RandomInt(spawn), maxParticles - alive);
+		for(int i = alive, end = alive + count; i < end; ++i)
 		{
-			while(it2->exists)
-				++it2;
-
-			Particle& p = *it2;
-			p.exists = true;
-			p.life = particleLife;
-			p.pos = pos + Vec3::Random(posMin, posMax);
-			p.speed = Vec3::Random(speedMin, speedMax);
+			particles.life[i] = particleLife;
+			particles.pos[i] = pos + RandomVec3(posMin, posMax);
+			particles.speed[i] = RandomVec3(speedMin, speedMax);
 		}
 
 		alive += count;
@@ -144,6 +97,73 @@ bool ParticleEmitter::Update(float dt)
 	return false;
 }
 
+//=================================================================================================
+void ParticleEmitter::Finish()
+{
+	if(manualDelete == 0)
+		delete this;
+	else
+		manualDelete = 2;
+}
+
+//=================================================================================================
+void ParticleEmitter::UpdateParticles(float dt)
+{
+	// remove dead particles, last particle is moved in place of removed one
+	for(int i = 0; i < alive;)
+	{
+		if((particles.life[i] -= dt) <= 0.f)
+		{
+			--alive;
+			particles.pos[i] = particles.pos[alive];
+			particles.speed[i] = particles.speed[alive];
+			particles.life[i] = particles.life[alive];
+		}
+		else
+			++i;
+	}
+
+	// move particles, Vec3 arrays are processed as float arrays 4 particles (12 floats) at once
+	float* p = &particles.pos.data()->x;
+	float* v = &particles.speed.data()->x;
+	const __m128 vdt = _mm_set1_ps(dt);
+	const int count4 = alive & ~3;
+	if(gravity)
+	{
+		// speed.y is at float 1, 4, 7 and 10
+		const float g = G * dt;
+		const __m128 g0 = _mm_set_ps(0, 0, g, 0),
+			g1 = _mm_set_ps(g, 0, 0, g),
+			g2 = _mm_set_ps(0, g, 0, 0);
+		for(int i = 0; i < count4; i += 4, p += 12, v += 12)
+		{
+			__m128 v0 = _mm_loadu_ps(v), v1 = _mm_loadu_ps(v + 4), v2 = _mm_loadu_ps(v + 8);
+			_mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(v0, vdt)));
+			_mm_storeu_ps(p + 4, _mm_add_ps(_mm_loadu_ps(p + 4), _mm_mul_ps(v1, vdt)));
+			_mm_storeu_ps(p + 8, _mm_add_ps(_mm_loadu_ps(p + 8), _mm_mul_ps(v2, vdt)));
+			_mm_storeu_ps(v, _mm_sub_ps(v0, g0));
+			_mm_storeu_ps(v + 4, _mm_sub_ps(v1, g1));
+			_mm_storeu_ps(v + 8, _mm_sub_ps(v2, g2));
+		}
+		for(int i = count4; i < alive; ++i)
+		{
+			particles.pos[i] += particles.speed[i] * dt;
+			particles.speed[i].y -= g;
+		}
+	}
+	else
+	{
+		for(int i = 0; i < count4; i += 4, p += 12, v += 12)
+		{
+			_mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(_mm_loadu_ps(v), vdt)));
+			_mm_storeu_ps(p + 4, _mm_add_ps(_mm_loadu_ps(p + 4), _mm_mul_ps(_mm_loadu_ps(v + 4), vdt)));
+			_mm_storeu_ps(p + 8, _mm_add_ps(_mm_loadu_ps(p + 8), _mm_mul_ps(_mm_loadu_ps(v + 8), vdt)));
+		}
+		for(int i = count4; i < alive; ++i)
+			particles.pos[i] += particles.speed[i] * dt;
+	}
+}
+
 //=================================================================================================
 void ParticleEmitter::Save(FileWriter& f)
 {
@@ -165,7 +185,20 @@ void ParticleEmitter::Save(FileWriter& f)
 	f << manualDelete;
 	f << time;
 	f << radius;
-	f << particles;
+	// keep old format with all slots
+	f << maxParticles;
+	for(int i = 0; i < maxParticles; ++i)
+	{
+		Particle p = {};
+		if(i < alive)
+		{
+			p.pos = particles.pos[i];
+			p.speed = particles.speed[i];
+			p.life = particles.life[i];
+			p.exists = true;
+		}
+		f.Write(p);
+	}
 	f << alive;
 	f << destroy;
 	f << gravity;
@@ -192,8 +225,25 @@ void ParticleEmitter::Load(FileReader& f)
 	f >> manualDelete;
 	f >> time;
 	f >> radius;
-	f >> particles;
+	vector<Particle> saved;
+	f >> saved;
+	particles.pos.resize(maxParticles);
+	particles.speed.resize(maxParticles);
+	particles.life.resize(maxParticles);
+	int index = 0;
+	for(const Particle& p : saved)
+	{
+		if(p.exists && index < maxParticles)
+		{
+			particles.pos[index] = p.pos;
+			particles.speed[index] = p.speed;
+			particles.life[index] = p.life;
+			++index;
+		}
+	}
 	f >> alive;
+	alive = index;
+	rng.seed(RandU());
 	f >> destroy;
 	f >> gravity;
 }
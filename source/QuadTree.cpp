@@ -0,0 +1,180 @@
+#include "Pch.h"
+#include "QuadTree.h"
+
+//=================================================================================================
+void QuadTree::Init(QuadNode* node, const Box2d& box, const Rect& gridBox, int splits)
+{
+	if(!node)
+	{
+		assert(get && !top);
+		top = get();
+		node = top;
+	}
+
+	node->box = box;
+	node->gridBox = gridBox;
+	node->minY = -999.f;
+	node->maxY = 999.f;
+	node->leaf = (splits <= 0 || (gridBox.SizeX() <= 1 && gridBox.SizeY() <= 1));
+	if(node->leaf)
+	{
+		for(int i = 0; i < 4; ++i)
+			node->childs[i] = nullptr;
+		return;
+	}
+
+	// split on grid cell border
+	const Int2 gridMid((gridBox.p1.x + gridBox.p2.x) / 2, (gridBox.p1.y + gridBox.p2.y) / 2);
+	const Vec2 cellSize(box.SizeX() / gridBox.SizeX(), box.SizeY() / gridBox.SizeY());
+	const Vec2 mid(box.v1.x + cellSize.x * (gridMid.x - gridBox.p1.x), box.v1.y + cellSize.y * (gridMid.y - gridBox.p1.y));
+	const Rect childGrid[4] = {
+		Rect(gridBox.p1.x, gridBox.p1.y, gridMid.x, gridMid.y),
+		Rect(gridMid.x, gridBox.p1.y, gridBox.p2.x, gridMid.y),
+		Rect(gridBox.p1.x, gridMid.y, gridMid.x, gridBox.p2.y),
+		Rect(gridMid.x, gridMid.y, gridBox.p2.x, gridBox.p2.y)
+	};
+	const Box2d childBox[4] = {
+		Box2d(box.v1.x, box.v1.y, mid.x, mid.y),
+		Box2d(mid.x, box.v1.y, box.v2.x, mid.y),
+		Box2d(box.v1.x, mid.y, mid.x, box.v2.y),
+		Box2d(mid.x, mid.y, box.v2.x, box.v2.y)
+	};
+
+	for(int i = 0; i < 4; ++i)
+	{
+		if(childGrid[i].SizeX() <= 0 || childGrid[i].SizeY() <= 0)
+			node->childs[i] = nullptr;
+		else
+		{
+			node->childs[i] = get();
+			Init(node->childs[i], childBox[i], childGrid[i], splits - 1);
+		}
+	}
+}
+
+//=================================================================================================
+void QuadTree::List(const FrustumPlanes& frustum, Nodes& nodes) const
+{
+	nodes.clear();
+	if(!top)
+		return;
+
+	tmpNodes.push_back(top);
+	while(!tmpNodes.empty())
+	{
+		QuadNode* node = tmpNodes.back();
+		tmpNodes.pop_back();
+		if(frustum.BoxToFrustum(Box::CreateXZ(node->box, node->minY, node->maxY)))
+		{
+			nodes.push_back(node);
+			if(!node->leaf)
+			{
+				for(QuadNode* child : node->childs)
+				{
+					if(child)
+						tmpNodes.push_back(child);
+				}
+			}
+		}
+	}
+}
+
+//=================================================================================================
+void QuadTree::ListLeafs(const FrustumPlanes& frustum, Nodes& nodes) const
+{
+	nodes.clear();
+	if(!top)
+		return;
+
+	tmpNodes.push_back(top);
+	while(!tmpNodes.empty())
+	{
+		QuadNode* node = tmpNodes.back();
+		tmpNodes.pop_back();
+		const Box box = Box::CreateXZ(node->box, node->minY, node->maxY);
+		if(!frustum.BoxToFrustum(box))
+			continue;
+
+		if(node->leaf)
+			nodes.push_back(node);
+		else if(frustum.BoxInFrustum(box))
+		{
+			// whole subtree is visible, add leafs without testing
+			const uint start = tmpNodes.size();
+			tmpNodes.push_back(node);
+			while(tmpNodes.size() > start)
+			{
+				QuadNode* subnode = tmpNodes.back();
+				tmpNodes.pop_back();
+				if(subnode->leaf)
+					nodes.push_back(subnode);
+				else
+				{
+					for(QuadNode* child : subnode->childs)
+					{
+						if(child)
+							tmpNodes.push_back(child);
+					}
+				}
+			}
+		}
+		else
+		{
+			for(QuadNode* child : node->childs)
+			{
+				if(child)
+					tmpNodes.push_back(child);
+			}
+		}
+	}
+}
+
+//=================================================================================================
+void QuadTree::Clear(Nodes& nodes)
+{
+	if(!top)
+		return;
+
+	tmpNodes.push_back(top);
+	while(!tmpNodes.empty())
+	{
+		QuadNode* node = tmpNodes.back();
+		tmpNodes.pop_back();
+		if(!node->leaf)
+		{
+			for(QuadNode* child : node->childs)
+			{
+				if(child)
+					tmpNodes.push_back(child);
+			}
+		}
+		nodes.push_back(node);
+	}
+
+	top = nullptr;
+}
+
+//=================================================================================================
+QuadNode* QuadTree::GetNode(const Vec2& pos, float radius)
+{
+	QuadNode* node = top;
+	if(!node || !node->box.IsFullyInside(pos, radius))
+		return nullptr;
+
+	while(!node->leaf)
+	{
+		QuadNode* found = nullptr;
+		for(QuadNode* child : node->childs)
+		{
+			if(child && child->box.IsFullyInside(pos, radius))
+			{
+				found = child;
+				break;
+			}
+		}
+		if(!found)
+			break;
+		node = found;
+	}
+	return node;
+}
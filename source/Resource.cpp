@@ -20,7 +20,32 @@ Buffer* Resource::GetBuffer()
 		return FileReader::ReadToBuffer(path);
 
 	Pak::File& file = pak->files[pakIndex];
-	Buffer* buf = pak->file.ReadToBuffer(file.offset, file.compressedSize);
+	if(pak->IsChunked(file))
+	{
+		PakEntryReader reader(pak, pakIndex);
+		return reader.ReadToBuffer(file.size);
+	}
+
+	Buffer* buf;
+	if(pak->mapping.IsOpen())
+	{
+		const byte* data = pak->mapping.At(file.offset);
+		if(!pak->encrypted && file.compressedSize != file.size)
+			return io::Decompress(data, file.compressedSize, file.size);
+		buf = Buffer::Get();
+		buf->Resize(file.compressedSize);
+		memcpy(buf->Data(), data, file.compressedSize);
+	}
+	else
+	{
+		buf = Buffer::Get();
+		buf->Resize(file.compressedSize);
+		if(!pak->file.ReadAt(file.offset, buf->Data(), file.compressedSize))
+		{
+			buf->Free();
+			return nullptr;
+		}
+	}
 	if(pak->encrypted)
 		io::Crypt((char*)buf->Data(), buf->Size(), pak->key.c_str(), pak->key.length());
 	if(file.compressedSize != file.size)
@@ -28,6 +53,19 @@ Buffer* Resource::GetBuffer()
 	return buf;
 }
 
+//=================================================================================================
+const byte* Resource::GetView(uint& size) const
+{
+	if(!pak || !pak->mapping.IsOpen() || pak->encrypted)
+		return nullptr;
+
+	Pak::File& file = pak->files[pakIndex];
+	if(file.compressedSize != file.size)
+		return nullptr;
+	size = file.size;
+	return pak->mapping.At(file.offset);
+}
+
 //=================================================================================================
 void Resource::EnsureIsLoaded()
 {
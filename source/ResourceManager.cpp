@@ -8,6 +8,7 @@
 #include "Render.h"
 #include "SoundManager.h"
 #include "WICTextureLoader.h"
+#include "WindowsIncludes.h"
 
 ResourceManager* app::resMgr;
 
@@ -21,14 +22,14 @@ extern uint capsuleQmshLen;
 extern uint cylinderQmshLen;
 
 //=================================================================================================
-ResourceManager::ResourceManager() : mode(Mode::Instant), tmpMesh(nullptr)
+ResourceManager::ResourceManager() : mode(Mode::Instant), loadThreads(0), asyncEvent(nullptr), asyncBudget(0.002f), asyncOrder(0)
 {
 }
 
 //=================================================================================================
 ResourceManager::~ResourceManager()
 {
-	delete tmpMesh;
+	StopAsync();
 
 	for(Resource* res : resources)
 		delete res;
@@ -130,7 +131,7 @@ bool ResourceManager::AddDir(cstring dir, bool subdir)
 }
 
 //=================================================================================================
-bool ResourceManager::AddPak(cstring path, cstring key)
+bool ResourceManager::AddPak(cstring path, cstring key, bool mapped)
 {
 	assert(path);
 
@@ -154,7 +155,7 @@ bool ResourceManager::AddPak(cstring path, cstring key)
 		Error("ResourceManager: Failed to read pak '%s', invalid signature %c%c%c.", path, header.sign[0], header.sign[1], header.sign[2]);
 		return false;
 	}
-	if(header.version != 1)
+	if(header.version < 1 || header.version > Pak::CURRENT_VERSION)
 	{
 		Error("ResourceManager: Failed to read pak '%s', invalid version %d.", path, (int)header.version);
 		return false;
@@ -194,6 +195,14 @@ bool ResourceManager::AddPak(cstring path, cstring key)
 
 	// setup pak
 	Pak* pak = new Pak;
+	if(mapped && !pak->mapping.Open(path))
+	{
+		buf->Free();
+		Error("ResourceManager: Failed to map pak '%s' (%u).", path, GetLastError());
+		delete pak;
+		return false;
+	}
+	pak->version = header.version;
 	pak->encrypted = IsSet(header.flags, Pak::FullEncrypted);
 	if(key)
 		pak->key = key;
@@ -231,7 +240,10 @@ bool ResourceManager::AddPak(cstring path, cstring key)
 		}
 	}
 
-	pak->file = f;
+	if(mapped)
+		f.Close();
+	else
+		pak->file = f;
 	pak->path = path;
 	paks.push_back(pak);
 
@@ -249,10 +261,15 @@ Resource* ResourceManager::AddResource(cstring filename, cstring path)
 
 	Resource* res = CreateResource(type);
 	res->filename = filename;
+	res->hash = HashNoCase(filename);
 	res->type = type;
 
-	pair<ResourceIterator, bool> result = resources.insert(res);
-	if(result.second)
+	Resource* existing;
+	{
+		std::unique_lock<std::shared_mutex> lock(resourcesLock);
+		existing = resources.Insert(res);
+	}
+	if(!existing)
 	{
 		// added
 		res->state = ResourceState::NotLoaded;
@@ -261,7 +278,6 @@ Resource* ResourceManager::AddResource(cstring filename, cstring path)
 	else
 	{
 		// already exists
-		Resource* existing = *result.first;
 		if(existing->pak || existing->path != path)
 			Warn("ResourceManager: Resource '%s' already exists (%s; %s).", filename, existing->GetPath(), path);
 		delete res;
@@ -274,8 +290,9 @@ void ResourceManager::AddResource(Resource* res)
 {
 	assert(res);
 
-	pair<ResourceIterator, bool> result = resources.insert(res);
-	if(!result.second)
+	res->hash = HashNoCase(res->filename);
+	std::unique_lock<std::shared_mutex> lock(resourcesLock);
+	if(resources.Insert(res))
 		Warn("ResourceManager: Resource '%s' already added.", res->filename);
 }
 
@@ -303,15 +320,13 @@ Resource* ResourceManager::CreateResource(ResourceType type)
 //=================================================================================================
 Resource* ResourceManager::TryGetResource(Cstring filename, ResourceType type)
 {
-	resSearch.filename = filename;
-	auto it = resources.find(&resSearch);
-	if(it != resources.end())
+	Resource* res;
 	{
-		assert((*it)->type == type);
-		return *it;
+		std::shared_lock<std::shared_mutex> lock(resourcesLock);
+		res = resources.Find(filename, HashNoCase(filename));
 	}
-	else
-		return nullptr;
+	assert(!res || res->type == type);
+	return res;
 }
 
 //=================================================================================================
@@ -354,13 +369,16 @@ void ResourceManager::Load(Resource* res)
 	assert(res);
 	if(res->state == ResourceState::Loaded)
 		return;
-	if(mode != Mode::LoadScreenPrepare)
+	if(mode != Mode::LoadScreenPrepare || res->state == ResourceState::Queued)
 		LoadResourceInternal(res);
 	else if(res->state == ResourceState::NotLoaded)
 	{
 		TaskDetail* td = taskPool.Get();
 		td->data.res = res;
 		td->type = TaskType::Load;
+		td->prepared = nullptr;
+		td->error.clear();
+		td->ready = false;
 		tasks.push_back(td);
 		++toLoad;
 
@@ -376,6 +394,267 @@ void ResourceManager::LoadInstant(Resource* res)
 		LoadResourceInternal(res);
 }
 
+//=================================================================================================
+void ResourceManager::LoadAsync(Resource* res, int priority, ResourceCallback callback)
+{
+	assert(res);
+
+	switch(res->state)
+	{
+	case ResourceState::Loaded:
+		if(callback)
+			callback(res);
+		return;
+	case ResourceState::Loading:
+		// already added to load screen, load it now
+		LoadResourceInternal(res);
+		if(callback)
+			callback(res);
+		return;
+	case ResourceState::Queued:
+		{
+			AsyncRequest* req = asyncRequests[res];
+			req->canceled = false;
+			if(callback)
+				req->callbacks.push_back(callback);
+			if(priority > req->priority)
+				SetAsyncPriority(res, priority);
+		}
+		return;
+	default:
+		break;
+	}
+
+	if(!asyncEvent)
+		StartAsync();
+
+	AsyncRequest* req = asyncPool.Get();
+	req->res = res;
+	req->callbacks.clear();
+	if(callback)
+		req->callbacks.push_back(callback);
+	req->priority = priority;
+	req->order = asyncOrder++;
+	req->canceled = false;
+	req->prepared = nullptr;
+	req->error.clear();
+	req->ready = false;
+	asyncRequests[res] = req;
+	res->state = ResourceState::Queued;
+
+	{
+		StartCriticalSection section(asyncCs);
+		asyncQueue.push_back(req);
+		std::push_heap(asyncQueue.begin(), asyncQueue.end(), AsyncRequest::Less);
+	}
+	SetEvent(static_cast<HANDLE>(asyncEvent));
+}
+
+//=================================================================================================
+void ResourceManager::SetAsyncPriority(Resource* res, int priority)
+{
+	assert(res);
+
+	auto it = asyncRequests.find(res);
+	if(it == asyncRequests.end())
+		return;
+
+	StartCriticalSection section(asyncCs);
+	it->second->priority = priority;
+	std::make_heap(asyncQueue.begin(), asyncQueue.end(), AsyncRequest::Less);
+}
+
+//=================================================================================================
+void ResourceManager::CancelAsync(Resource* res)
+{
+	assert(res);
+
+	auto it = asyncRequests.find(res);
+	if(it == asyncRequests.end())
+		return;
+
+	AsyncRequest* req = it->second;
+	if(RemoveQueuedAsync(req))
+	{
+		asyncRequests.erase(it);
+		asyncPool.Free(req);
+		res->state = ResourceState::NotLoaded;
+	}
+	else
+	{
+		// background thread is working on it, discard result in UpdateAsync
+		req->canceled = true;
+		req->callbacks.clear();
+	}
+}
+
+//=================================================================================================
+void ResourceManager::UpdateAsync()
+{
+	if(asyncRequests.empty())
+		return;
+
+	// always complete at least one request to guarantee progress
+	Timer t;
+	float elapsed = 0.f;
+	do
+	{
+		AsyncRequest* req;
+		{
+			StartCriticalSection section(asyncCs);
+			if(asyncDone.empty())
+				break;
+			req = asyncDone.front();
+			asyncDone.erase(asyncDone.begin());
+		}
+		CompleteAsync(req);
+		elapsed += t.Tick();
+	}
+	while(elapsed < asyncBudget);
+}
+
+//=================================================================================================
+void ResourceManager::StartAsync()
+{
+	asyncCs.Create();
+	asyncEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	asyncQuit = false;
+	asyncThread = thread(&ResourceManager::RunAsyncWorker, this);
+}
+
+//=================================================================================================
+void ResourceManager::StopAsync()
+{
+	if(!asyncEvent)
+		return;
+
+	{
+		StartCriticalSection section(asyncCs);
+		asyncQuit = true;
+	}
+	SetEvent(static_cast<HANDLE>(asyncEvent));
+	asyncThread.join();
+	CloseHandle(static_cast<HANDLE>(asyncEvent));
+	asyncEvent = nullptr;
+	asyncCs.Free();
+
+	for(pair<Resource* const, AsyncRequest*>& it : asyncRequests)
+	{
+		AsyncRequest* req = it.second;
+		if(req->prepared)
+			req->prepared->Free();
+		req->res->state = ResourceState::NotLoaded;
+		asyncPool.Free(req);
+	}
+	asyncRequests.clear();
+	asyncQueue.clear();
+	asyncDone.clear();
+}
+
+//=================================================================================================
+void ResourceManager::RunAsyncWorker()
+{
+	while(true)
+	{
+		WaitForSingleObject(static_cast<HANDLE>(asyncEvent), INFINITE);
+
+		while(true)
+		{
+			AsyncRequest* req;
+			{
+				StartCriticalSection section(asyncCs);
+				if(asyncQuit)
+					return;
+				if(asyncQueue.empty())
+					break;
+				std::pop_heap(asyncQueue.begin(), asyncQueue.end(), AsyncRequest::Less);
+				req = asyncQueue.back();
+				asyncQueue.pop_back();
+			}
+
+			try
+			{
+				req->prepared = PrepareResource(req->res);
+			}
+			catch(cstring err)
+			{
+				req->error = err;
+			}
+			catch(const std::exception& ex)
+			{
+				req->error = Format("Unhandled exception: %s", ex.what());
+			}
+			catch(...)
+			{
+				req->error = "Unknown exception.";
+			}
+
+			// main thread can free request as soon as it's in done list
+			{
+				StartCriticalSection section(asyncCs);
+				req->ready = true;
+				asyncDone.push_back(req);
+			}
+		}
+	}
+}
+
+//=================================================================================================
+// Remove request that wasn't yet taken by background thread
+bool ResourceManager::RemoveQueuedAsync(AsyncRequest* req)
+{
+	StartCriticalSection section(asyncCs);
+	auto it = std::find(asyncQueue.begin(), asyncQueue.end(), req);
+	if(it == asyncQueue.end())
+		return false;
+	asyncQueue.erase(it);
+	std::make_heap(asyncQueue.begin(), asyncQueue.end(), AsyncRequest::Less);
+	return true;
+}
+
+//=================================================================================================
+// Create device objects for request prepared in background & call callbacks
+// When instant (resource was taken over by Load) error is thrown instead of logged
+void ResourceManager::CompleteAsync(AsyncRequest* req, bool instant)
+{
+	Resource* res = req->res;
+	Buffer* prepared = req->prepared;
+	vector<ResourceCallback> callbacks;
+	callbacks.swap(req->callbacks);
+	const bool canceled = req->canceled;
+	string error = req->error;
+	asyncRequests.erase(res);
+	asyncPool.Free(req);
+
+	if(canceled || !error.empty())
+	{
+		if(prepared)
+			prepared->Free();
+		res->state = ResourceState::NotLoaded;
+		if(canceled)
+			return;
+	}
+	else
+	{
+		try
+		{
+			FinalizeResource(res, prepared);
+		}
+		catch(cstring err)
+		{
+			res->state = ResourceState::NotLoaded;
+			error = err;
+		}
+	}
+
+	if(!error.empty() && !instant)
+		Error("ResourceManager: Failed to load '%s' in background. %s", res->filename, error.c_str());
+	for(ResourceCallback& callback : callbacks)
+		callback(res);
+	if(!error.empty() && instant)
+		throw Format("%s", error.c_str());
+}
+
 //=================================================================================================
 ResourceType ResourceManager::ExtToResourceType(cstring ext)
 {
@@ -442,7 +721,22 @@ void ResourceManager::StartLoadScreen(cstring category)
 	mode = Mode::LoadScreenRuning;
 	if(category)
 		this->category = category;
-	UpdateLoadScreen();
+	if(loadThreads > 0)
+	{
+		StartWorkers();
+		try
+		{
+			UpdateLoadScreen();
+		}
+		catch(...)
+		{
+			StopWorkers();
+			throw;
+		}
+		StopWorkers();
+	}
+	else
+		UpdateLoadScreen();
 	mode = Mode::Instant;
 	taskPool.Free(tasks);
 }
@@ -502,7 +796,12 @@ void ResourceManager::UpdateLoadScreen()
 			break;
 		case TaskType::Load:
 			if(task->data.res->state != ResourceState::Loaded)
-				LoadResourceInternal(task->data.res);
+			{
+				if(workers.empty())
+					LoadResourceInternal(task->data.res);
+				else
+					FinishJob(task);
+			}
 			++loaded;
 			break;
 		default:
@@ -532,11 +831,152 @@ void ResourceManager::TickLoadScreen()
 	}
 }
 
+//=================================================================================================
+// Load tasks are split between threads, main thread handles tasks in order and only creates device
+// objects for resources prepared by workers (so callbacks still see previous resources loaded)
+void ResourceManager::StartWorkers()
+{
+	assert(workers.empty() && jobs.empty());
+
+	for(TaskDetail* task : tasks)
+	{
+		if(task->type == TaskType::Load)
+			jobs.push_back(task);
+	}
+	if(jobs.empty())
+		return;
+
+	nextJob = 0;
+	const uint count = min(loadThreads, (uint)jobs.size());
+	workers.reserve(count);
+	for(uint i = 0; i < count; ++i)
+		workers.push_back(thread(&ResourceManager::RunWorker, this));
+}
+
+//=================================================================================================
+void ResourceManager::StopWorkers()
+{
+	nextJob = (uint)jobs.size();
+	for(thread& worker : workers)
+		worker.join();
+	workers.clear();
+
+	// free results that weren't used (after error)
+	for(TaskDetail* task : jobs)
+	{
+		if(task->prepared)
+		{
+			task->prepared->Free();
+			task->prepared = nullptr;
+		}
+	}
+	jobs.clear();
+}
+
+//=================================================================================================
+void ResourceManager::RunWorker()
+{
+	while(true)
+	{
+		const uint index = nextJob++;
+		if(index >= jobs.size())
+			break;
+
+		TaskDetail* task = jobs[index];
+		try
+		{
+			task->prepared = PrepareResource(task->data.res);
+		}
+		catch(cstring err)
+		{
+			task->error = err;
+		}
+		catch(const std::exception& ex)
+		{
+			task->error = Format("Unhandled exception: %s", ex.what());
+		}
+		catch(...)
+		{
+			task->error = "Unknown exception.";
+		}
+		task->ready = true;
+	}
+}
+
+//=================================================================================================
+void ResourceManager::FinishJob(TaskDetail* task)
+{
+	while(!task->ready)
+	{
+		TickLoadScreen();
+		std::this_thread::yield();
+	}
+
+	Buffer* prepared = task->prepared;
+	task->prepared = nullptr;
+	if(!task->error.empty())
+	{
+		if(prepared)
+			prepared->Free();
+		throw Format("%s", task->error.c_str());
+	}
+
+	FinalizeResource(task->data.res, prepared);
+}
+
 //=================================================================================================
 void ResourceManager::LoadResourceInternal(Resource* res)
 {
 	assert(res->state != ResourceState::Loaded);
 
+	// resource is loaded in background, take it over
+	if(res->state == ResourceState::Queued)
+	{
+		AsyncRequest* req = asyncRequests[res];
+		req->canceled = false;
+		if(RemoveQueuedAsync(req))
+		{
+			try
+			{
+				req->prepared = PrepareResource(res);
+			}
+			catch(cstring err)
+			{
+				req->error = err;
+			}
+			catch(const std::exception& ex)
+			{
+				req->error = Format("Unhandled exception: %s", ex.what());
+			}
+			catch(...)
+			{
+				req->error = "Unknown exception.";
+			}
+		}
+		else
+		{
+			while(!req->ready)
+				std::this_thread::yield();
+			StartCriticalSection section(asyncCs);
+			RemoveElement(asyncDone, req);
+		}
+		CompleteAsync(req, true);
+		return;
+	}
+
+	// resource can be already processed by loading thread
+	if(res->state == ResourceState::Loading && !workers.empty())
+	{
+		for(TaskDetail* task : jobs)
+		{
+			if(task->data.res == res)
+			{
+				FinishJob(task);
+				return;
+			}
+		}
+	}
+
 	switch(res->type)
 	{
 	case ResourceType::Mesh:
@@ -560,21 +1000,87 @@ void ResourceManager::LoadResourceInternal(Resource* res)
 	res->state = ResourceState::Loaded;
 }
 
+//=================================================================================================
+// Read & parse resource data, called from loading threads so it can't use device context
+Buffer* ResourceManager::PrepareResource(Resource* res)
+{
+	switch(res->type)
+	{
+	case ResourceType::Mesh:
+		return LoadMeshData(static_cast<Mesh*>(res));
+	case ResourceType::VertexData:
+		LoadVertexData(static_cast<VertexData*>(res));
+		return nullptr;
+	case ResourceType::Texture:
+		{
+			uint size;
+			if(res->IsFile())
+				return FileReader::ReadToBuffer(res->path);
+			else if(res->GetView(size))
+				return nullptr;
+			else
+				return res->GetBuffer();
+		}
+	default:
+		return nullptr;
+	}
+}
+
+//=================================================================================================
+// Create device objects for resource prepared by PrepareResource (takes ownership of prepared data)
+void ResourceManager::FinalizeResource(Resource* res, Buffer* prepared)
+{
+	switch(res->type)
+	{
+	case ResourceType::Mesh:
+		CreateMesh(static_cast<Mesh*>(res), prepared);
+		break;
+	case ResourceType::VertexData:
+		break;
+	case ResourceType::Sound:
+	case ResourceType::Music:
+		LoadSoundOrMusic(static_cast<Sound*>(res));
+		break;
+	case ResourceType::Texture:
+		if(prepared)
+			LoadTexture(static_cast<Texture*>(res), prepared);
+		else
+			LoadTexture(static_cast<Texture*>(res));
+		break;
+	default:
+		assert(0);
+		break;
+	}
+
+	res->state = ResourceState::Loaded;
+}
+
 //=================================================================================================
 void ResourceManager::LoadMesh(Mesh* mesh)
+{
+	CreateMesh(mesh, LoadMeshData(mesh));
+}
+
+//=================================================================================================
+Buffer* ResourceManager::LoadMeshData(Mesh* mesh)
 {
 	try
 	{
-		ID3D11Device* device = app::render->GetDevice();
+		uint size;
 		if(mesh->IsFile())
 		{
-			FileReader f(mesh->path);
-			mesh->Load(f, device);
+			BufferedFileReader f(mesh->path);
+			return mesh->LoadData(f);
+		}
+		else if(const byte* data = mesh->GetView(size))
+		{
+			MemoryReader f(data, size);
+			return mesh->LoadData(f);
 		}
 		else
 		{
 			MemoryReader f(mesh->GetBuffer());
-			mesh->Load(f, device);
+			return mesh->LoadData(f);
 		}
 	}
 	catch(cstring err)
@@ -583,19 +1089,38 @@ void ResourceManager::LoadMesh(Mesh* mesh)
 	}
 }
 
+//=================================================================================================
+void ResourceManager::CreateMesh(Mesh* mesh, Buffer* data)
+{
+	try
+	{
+		mesh->CreateBuffers(data, app::render->GetDevice());
+	}
+	catch(cstring err)
+	{
+		throw Format("ResourceManager: Failed to load mesh '%s'. %s", mesh->GetPath(), err);
+	}
+}
+
 //=================================================================================================
 void ResourceManager::LoadMeshMetadata(Mesh* mesh)
 {
 	try
 	{
+		uint size;
 		if(mesh->IsFile())
 		{
-			FileReader f(mesh->path);
+			BufferedFileReader f(mesh->path);
+			mesh->LoadMetadata(f);
+		}
+		else if(const byte* data = mesh->GetView(size))
+		{
+			MemoryReader f(data, size);
 			mesh->LoadMetadata(f);
 		}
 		else
 		{
-			MemoryReader f(mesh->GetBuffer());
+			PakEntryReader f(mesh->pak, mesh->pakIndex);
 			mesh->LoadMetadata(f);
 		}
 	}
@@ -610,18 +1135,23 @@ void ResourceManager::LoadVertexData(VertexData* vd)
 {
 	try
 	{
-		if(!tmpMesh)
-			tmpMesh = new Mesh();
-
+		// only header is loaded to mesh so it's cheap, local mesh allows loading from multiple threads
+		Mesh mesh;
+		uint size;
 		if(vd->IsFile())
 		{
-			FileReader f(vd->path);
-			tmpMesh->LoadVertexData(vd, f);
+			BufferedFileReader f(vd->path);
+			mesh.LoadVertexData(vd, f);
+		}
+		else if(const byte* data = vd->GetView(size))
+		{
+			MemoryReader f(data, size);
+			mesh.LoadVertexData(vd, f);
 		}
 		else
 		{
 			MemoryReader f(vd->GetBuffer());
-			tmpMesh->LoadVertexData(vd, f);
+			mesh.LoadVertexData(vd, f);
 		}
 	}
 	catch(cstring err)
@@ -642,22 +1172,37 @@ void ResourceManager::LoadSoundOrMusic(Sound* sound)
 void ResourceManager::LoadTexture(Texture* tex)
 {
 	HRESULT hr;
+	uint size;
 	if(tex->IsFile())
 	{
 		hr = CreateWICTextureFromFileEx(app::render->GetDevice(), app::render->GetDeviceContext(), ToWString(tex->path.c_str()), 0u,
 			D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, WIC_LOADER_IGNORE_SRGB, nullptr, &tex->tex);
 	}
-	else
+	else if(const byte* data = tex->GetView(size))
 	{
-		BufferHandle&& buf = tex->GetBuffer();
-		hr = CreateWICTextureFromMemoryEx(app::render->GetDevice(), app::render->GetDeviceContext(), static_cast<byte*>(buf->Data()), buf->Size(), 0u,
+		hr = CreateWICTextureFromMemoryEx(app::render->GetDevice(), app::render->GetDeviceContext(), data, size, 0u,
 			D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, WIC_LOADER_IGNORE_SRGB, nullptr, &tex->tex);
 	}
+	else
+	{
+		LoadTexture(tex, tex->GetBuffer());
+		return;
+	}
 
 	if(FAILED(hr))
 		throw Format("Failed to load texture '%s' (%u).", tex->GetPath(), hr);
 }
 
+//=================================================================================================
+void ResourceManager::LoadTexture(Texture* tex, Buffer* buf)
+{
+	BufferHandle handle(buf);
+	HRESULT hr = CreateWICTextureFromMemoryEx(app::render->GetDevice(), app::render->GetDeviceContext(), static_cast<byte*>(buf->Data()), buf->Size(), 0u,
+		D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, WIC_LOADER_IGNORE_SRGB, nullptr, &tex->tex);
+	if(FAILED(hr))
+		throw Format("Failed to load texture '%s' (%u).", tex->GetPath(), hr);
+}
+
 //=================================================================================================
 TEX ResourceManager::LoadRawTexture(cstring path)
 {
@@ -693,6 +1238,7 @@ void ResourceManager::LoadBuiltinMesh(cstring name, byte* data, uint size)
 	mesh->type = ResourceType::Mesh;
 	mesh->path = Format("builtin/%s.qmsh", name);
 	mesh->filename = mesh->path.c_str();
+	mesh->hash = HashNoCase(mesh->filename);
 	mesh->state = ResourceState::Loaded;
 	mesh->pak = nullptr;
 
@@ -700,7 +1246,8 @@ void ResourceManager::LoadBuiltinMesh(cstring name, byte* data, uint size)
 	{
 		MemoryReader f(buf);
 		mesh->Load(f, app::render->GetDevice());
-		resources.insert(mesh);
+		std::unique_lock<std::shared_mutex> lock(resourcesLock);
+		resources.Insert(mesh);
 	}
 	catch(cstring err)
 	{
@@ -733,3 +1280,67 @@ uint ResourceManager::VerifyResources()
 
 	return errors;
 }
+
+//=================================================================================================
+Resource* ResourceManager::ResourceContainer::Find(cstring filename, uint hash) const
+{
+	if(capacity == 0)
+		return nullptr;
+
+	const uint mask = capacity - 1;
+	for(uint index = hash & mask;; index = (index + 1) & mask)
+	{
+		Resource* res = table[index];
+		if(!res)
+			return nullptr;
+		if(res->hash == hash && _stricmp(res->filename, filename) == 0)
+			return res;
+	}
+}
+
+//=================================================================================================
+Resource* ResourceManager::ResourceContainer::Insert(Resource* res)
+{
+	assert(res && res->hash == HashNoCase(res->filename));
+
+	// keep load factor below 1/2
+	if((count + 1) * 2 > capacity)
+		Grow();
+
+	const uint mask = capacity - 1;
+	uint index = res->hash & mask;
+	while(Resource* existing = table[index])
+	{
+		if(existing->hash == res->hash && _stricmp(existing->filename, res->filename) == 0)
+			return existing;
+		index = (index + 1) & mask;
+	}
+
+	table[index] = res;
+	++count;
+	return nullptr;
+}
+
+//=================================================================================================
+void ResourceManager::ResourceContainer::Grow()
+{
+	const uint newCapacity = (capacity == 0 ? 1024 : capacity * 2);
+	const uint mask = newCapacity - 1;
+	Resource** newTable = new Resource*[newCapacity];
+	memset(newTable, 0, sizeof(Resource*) * newCapacity);
+
+	for(uint i = 0; i < capacity; ++i)
+	{
+		Resource* res = table[i];
+		if(!res)
+			continue;
+		uint index = res->hash & mask;
+		while(newTable[index])
+			index = (index + 1) & mask;
+		newTable[index] = res;
+	}
+
+	delete[] table;
+	table = newTable;
+	capacity = newCapacity;
+}
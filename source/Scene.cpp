@@ -7,6 +7,7 @@
 #include "SceneManager.h"
 #include "SceneNode.h"
 #include "Terrain.h"
+#include "ThreadPool.h"
 
 //=================================================================================================
 Scene::Scene() : terrain(nullptr), skybox(nullptr), customMesh(customMesh), clearColor(Color::Black), ambientColor(0.4f, 0.4f, 0.4f), lightColor(Color::White),
@@ -20,32 +21,89 @@ Scene::~Scene()
 	Clear();
 }
 
+//=================================================================================================
+inline Box GetBox(SceneNode* node)
+{
+	return Box(Box(node->pos), node->radius);
+}
+
+//=================================================================================================
+void Scene::Add(SceneNode* node)
+{
+	assert(node && node->proxy == AabbTree::INVALID);
+	node->scene = this;
+	node->sceneIndex = (uint)nodes.size();
+	node->proxy = tree.Insert(GetBox(node), node);
+	nodes.push_back(node);
+}
+
 //=================================================================================================
 void Scene::Remove(SceneNode* node)
 {
-	assert(node);
-	RemoveElement(nodes, node);
+	Detach(node);
 	node->Free();
 }
 
 //=================================================================================================
 void Scene::Detach(SceneNode* node)
 {
-	assert(node);
-	RemoveElement(nodes, node);
+	assert(node && node->proxy != AabbTree::INVALID && nodes[node->sceneIndex] == node);
+	tree.Remove(node->proxy);
+	node->scene = nullptr;
+	node->proxy = AabbTree::INVALID;
+
+	SceneNode* last = nodes.back();
+	last->sceneIndex = node->sceneIndex;
+	nodes[node->sceneIndex] = last;
+	nodes.pop_back();
+}
+
+//=================================================================================================
+void Scene::UpdateNode(SceneNode* node)
+{
+	assert(node && node->scene == this && node->proxy != AabbTree::INVALID);
+	tree.Move(node->proxy, GetBox(node));
 }
 
 //=================================================================================================
 void Scene::Update(float dt)
 {
-	LoopAndRemove(particleEmitters, [=](ParticleEmitter* particleEmitter) { return particleEmitter->Update(dt); });
+	// update emitters in parallel, finished ones are deleted after all are done
+	const uint count = (uint)particleEmitters.size();
+	updateDt = dt;
+	emitterFinished.resize(count);
+	app::threadPool->ParallelFor(count, ThreadPool::Job(this, &Scene::UpdateEmitter));
+
+	uint index = 0;
+	for(uint i = 0; i < count; ++i)
+	{
+		ParticleEmitter* particleEmitter = particleEmitters[i];
+		if(emitterFinished[i])
+			particleEmitter->Finish();
+		else
+			particleEmitters[index++] = particleEmitter;
+	}
+	particleEmitters.resize(index);
+}
+
+//=================================================================================================
+void Scene::UpdateEmitter(uint index)
+{
+	emitterFinished[index] = particleEmitters[index]->Simulate(updateDt);
 }
 
 //=================================================================================================
 void Scene::Clear()
 {
+	for(SceneNode* node : nodes)
+	{
+		node->scene = nullptr;
+		node->proxy = AabbTree::INVALID;
+	}
 	SceneNode::Free(nodes);
+	tree.Clear();
 	DeleteElements(lights);
+	lightGrid.Clear();
 	DeleteElements(particleEmitters);
 	delete terrain;
 }
@@ -57,32 +115,64 @@ void Scene::ListNodes(SceneBatch& batch)
 
 	if(batch.gatherLights)
 	{
+		lightGrid.Update(lights);
 		activeLights.clear();
+		spheres.Clear();
 		for(Light* light : lights)
+			spheres.Add(light->pos, light->range);
+		spheres.Test(frustum);
+		lightVisible.resize(lights.size());
+		for(uint i = 0, count = spheres.Size(); i < count; ++i)
 		{
-			if(frustum.SphereToFrustum(light->pos, light->range))
-				activeLights.push_back(light);
+			lightVisible[i] = spheres.IsVisible(i);
+			if(lightVisible[i])
+				activeLights.push_back(lights[i]);
 		}
 	}
 
-	for(SceneNode* node : nodes)
+	// nodes that are fully inside frustum don't need to be tested, rest is tested in batch
+	partialNodes.clear();
+	spheres.Clear();
+	tree.Query(frustum, [&](void* ptr, bool inside)
 	{
-		if(node->visible && frustum.SphereToFrustum(node->pos, node->radius))
+		SceneNode* node = static_cast<SceneNode*>(ptr);
+		if(!node->visible)
+			return;
+		if(inside)
+			AddNode(batch, node);
+		else
 		{
-			if(batch.gatherLights)
-				GatherLights(batch, node);
-			batch.Add(node);
+			partialNodes.push_back(node);
+			spheres.Add(node->pos, node->radius);
 		}
+	});
+	spheres.Test(frustum);
+	for(uint i = 0, count = spheres.Size(); i < count; ++i)
+	{
+		if(spheres.IsVisible(i))
+			AddNode(batch, partialNodes[i]);
 	}
 
+	spheres.Clear();
 	for(ParticleEmitter* particleEmitter : particleEmitters)
+		spheres.Add(particleEmitter->pos, particleEmitter->radius);
+	spheres.Test(frustum);
+	for(uint i = 0, count = spheres.Size(); i < count; ++i)
 	{
-		if(frustum.SphereToFrustum(particleEmitter->pos, particleEmitter->radius))
-			batch.particleEmitters.push_back(particleEmitter);
+		if(spheres.IsVisible(i))
+			batch.particleEmitters.push_back(particleEmitters[i]);
 	}
 
 	if(terrain)
-		terrain->ListVisibleParts(batch.terrainParts, frustum);
+		terrain->ListVisibleParts(batch.terrainParts, frustum, batch.camera->from);
+}
+
+//=================================================================================================
+void Scene::AddNode(SceneBatch& batch, SceneNode* node)
+{
+	if(batch.gatherLights)
+		GatherLights(batch, node);
+	batch.Add(node);
 }
 
 //=================================================================================================
@@ -90,8 +180,13 @@ void Scene::GatherLights(SceneBatch& batch, SceneNode* node)
 {
 	TopN<Light*, 3, float, std::less<>> best(nullptr, batch.camera->zfar);
 
-	for(Light* light : activeLights)
+	// only lights in cells overlapping node, in same order as activeLights
+	lightGrid.Query(node->pos, node->radius, nearLights);
+	for(uint index : nearLights)
 	{
+		if(!lightVisible[index])
+			continue;
+		Light* light = lights[index];
 		float dist = Vec3::Distance(node->pos, light->pos);
 		if(dist < light->range + node->radius)
 			best.Add(light, dist);
@@ -17,7 +17,8 @@
 SceneManager* app::sceneMgr;
 
 //=================================================================================================
-SceneManager::SceneManager() : scene(nullptr), camera(nullptr), useLighting(true), useFog(true), useNormalmap(true), useSpecularmap(true)
+SceneManager::SceneManager() : scene(nullptr), camera(nullptr), useLighting(true), useFog(true), useNormalmap(true), useSpecularmap(true),
+animLodDist{ 25.f, 60.f }, animLodRate(2)
 {
 }
 
@@ -30,6 +31,15 @@ void SceneManager::Init()
 	skyboxShader = app::render->GetShader<SkyboxShader>();
 }
 
+//=================================================================================================
+MeshInstance::Lod SceneManager::GetAnimationLod(float distSq) const
+{
+	int lod = MeshInstance::LOD_FULL;
+	while(lod < MeshInstance::LOD_MAX - 1 && distSq >= animLodDist[lod] * animLodDist[lod])
+		++lod;
+	return (MeshInstance::Lod)lod;
+}
+
 //=================================================================================================
 void SceneManager::SetScene(Scene* scene, Camera* camera)
 {
@@ -1,9 +1,12 @@
 #include "Pch.h"
 #include "SceneNode.h"
 
+#include "AabbTree.h"
 #include "Camera.h"
 #include "ResourceManager.h"
+#include "Scene.h"
 #include "SceneManager.h"
+#include "ThreadPool.h"
 
 //=================================================================================================
 void SceneNode::OnGet()
@@ -15,6 +18,8 @@ void SceneNode::OnGet()
 	meshInst = nullptr;
 	texOverride = nullptr;
 	subs = SPLIT_MASK;
+	scene = nullptr;
+	proxy = AabbTree::INVALID;
 	visible = true;
 }
 
@@ -55,12 +60,26 @@ void SceneNode::UpdateFlags()
 		flags |= SceneNode::F_HAVE_WEIGHTS;
 	if(IsSet(mesh->head.flags, Mesh::F_TANGENTS))
 		flags |= SceneNode::F_HAVE_TANGENTS;
+
+	// radius changed
+	if(scene)
+		scene->UpdateNode(this);
+}
+
+//=================================================================================================
+void SceneNode::SetPos(const Vec3& pos)
+{
+	this->pos = pos;
+	if(scene)
+		scene->UpdateNode(this);
 }
 
 //=================================================================================================
 void SceneNode::UpdateMatrix()
 {
 	mat = Matrix::Transform(pos, rot, scale);
+	if(scene)
+		scene->UpdateNode(this);
 }
 
 //=================================================================================================
@@ -71,6 +90,11 @@ void SceneBatch::Clear()
 	nodeGroups.clear();
 	particleEmitters.clear();
 	terrainParts.clear();
+	meshInsts.clear();
+	animLodCounter.fill(0);
+
+	static uint counter;
+	id = ++counter;
 }
 
 //=================================================================================================
@@ -96,8 +120,14 @@ void SceneBatch::Add(SceneNode* node)
 			node->flags |= SceneNode::F_SPECULAR_MAP;
 	}
 
-	if(node->meshInst)
-		node->meshInst->SetupBones();
+	MeshInstance* meshInst = node->meshInst;
+	if(meshInst && meshInst->IsUpdateNeeded() && meshInst->AddToBatch(id))
+	{
+		const MeshInstance::Lod lod = app::sceneMgr->GetAnimationLod(Vec3::DistanceSquared(node->pos, camera->from));
+		++animLodCounter[lod];
+		if(meshInst->UpdateLod(lod, app::sceneMgr->animLodRate))
+			meshInsts.push_back(meshInst);
+	}
 
 	if(IsSet(node->flags, SceneNode::F_ALPHA_BLEND))
 	{
@@ -111,6 +141,8 @@ void SceneBatch::Add(SceneNode* node)
 //=================================================================================================
 void SceneBatch::Process()
 {
+	SetupBones();
+
 	nodeGroups.clear();
 	if(!nodes.empty())
 	{
@@ -145,3 +177,21 @@ void SceneBatch::Process()
 		return node1->dist > node2->dist;
 	});
 }
+
+//=================================================================================================
+// Update bones of all added mesh instances, predraw callbacks are called on this thread (in order of adding)
+// and the rest is split between threads
+void SceneBatch::SetupBones()
+{
+	if(meshInsts.empty())
+		return;
+
+	for(MeshInstance* meshInst : meshInsts)
+	{
+		if(meshInst->HavePredraw())
+			meshInst->SetupBones(meshInst->GetLod());
+	}
+	RemoveElements(meshInsts, [](MeshInstance* meshInst) { return !meshInst->IsUpdateNeeded(); });
+
+	app::threadPool->ParallelFor((uint)meshInsts.size(), ThreadPool::Job(this, &SceneBatch::SetupBonesJob));
+}
@@ -3,31 +3,14 @@
 
 #include "DirectX.h"
 #include "Render.h"
+#include "SceneNode.h"
 #include "Texture.h"
 
-//-----------------------------------------------------------------------------
-void CalculateNormal(VTerrain& v1, VTerrain& v2, VTerrain& v3)
-{
-	Vec3 v01 = v2.pos - v1.pos;
-	Vec3 v02 = v3.pos - v1.pos;
-	Vec3 normal = v01.Cross(v02).Normalize();
-
-	v1.normal = normal;
-	v2.normal = normal;
-	v3.normal = normal;
-}
-
-//-----------------------------------------------------------------------------
-void CalculateNormal(Vec3& out, const Vec3& v1, const Vec3& v2, const Vec3& v3)
-{
-	Vec3 v01 = v2 - v1;
-	Vec3 v02 = v3 - v1;
-
-	out = v01.Cross(v02).Normalize();
-}
+static ObjectPool<QuadNode> quadNodePool;
 
 //=================================================================================================
-Terrain::Terrain() : vb(nullptr), vbStaging(nullptr), ib(nullptr), parts(nullptr), h(nullptr), texSplat(nullptr), tex(), state(0), uvMod(DEFAULT_UV_MOD)
+Terrain::Terrain() : vb(nullptr), vbStaging(nullptr), ib(nullptr), parts(nullptr), h(nullptr), texSplat(nullptr), tex(), state(0), uvMod(DEFAULT_UV_MOD),
+lodTolerance(DEFAULT_LOD_TOLERANCE), dirty(false)
 {
 }
 
@@ -40,6 +23,10 @@ Terrain::~Terrain()
 	delete texSplat;
 	delete[] parts;
 	delete[] h;
+
+	QuadTree::Nodes nodes;
+	quadTree.Clear(nodes);
+	quadNodePool.Free(nodes);
 }
 
 //=================================================================================================
@@ -55,13 +42,16 @@ void Terrain::Init(const Options& o)
 	tilesPerPart = o.tilesPerPart;
 	nTiles = nParts * tilesPerPart;
 	nTiles2 = nTiles * nTiles;
+	invTileSize = 1.f / tileSize;
 	tilesSize = tileSize * nTiles;
 	width = nTiles + 1;
 	width2 = width * width;
-	nTris = nTiles2 * 2;
-	nVerts = nTiles2 * 6;
-	partTris = tilesPerPart * tilesPerPart * 2;
-	partVerts = tilesPerPart * tilesPerPart * 6;
+	nVerts = width2;
+	smallIndices = (tilesPerPart * (width + 1) < 0x10000);
+	lodCount = 1;
+	while(lodCount < MAX_LODS && tilesPerPart % (1u << lodCount) == 0)
+		++lodCount;
+	lodErrors.resize(nParts2 * lodCount, Inf()); // use full detail until heights are known
 	texSize = o.texSize;
 	box.v1 = pos;
 	box.v2 = pos + Vec3(tilesSize, 0, tilesSize);
@@ -80,6 +70,12 @@ void Terrain::Init(const Options& o)
 		}
 	}
 
+	int splits = 0;
+	while((1u << splits) < nParts)
+		++splits;
+	quadTree.get = []() { return quadNodePool.Get(); };
+	quadTree.Init(nullptr, Box2d(box.v1.x, box.v1.z, box.v2.x, box.v2.z), Rect(0, 0, nParts, nParts), splits);
+
 	texSplat = app::render->CreateDynamicTexture(Int2(texSize));
 
 	state = 1;
@@ -109,72 +105,50 @@ void Terrain::Build(bool smooth)
 	V(device->CreateBuffer(&bufferDesc, nullptr, &vbStaging));
 	SetDebugName(vbStaging, "TerrainVbStaging");
 
-	// build mesh
+	// build mesh, one vertex per height map point
 	ID3D11DeviceContext* deviceContext = app::render->GetDeviceContext();
 	D3D11_MAPPED_SUBRESOURCE res;
 	V(deviceContext->Map(vbStaging, 0, D3D11_MAP_WRITE, 0, &res));
 	VTerrain* v = reinterpret_cast<VTerrain*>(res.pData);
 
-#define TRI(xx,zz,uu,vv) v[n++] = VTerrain((x+xx)*tileSize, h[x+xx+(z+zz)*width], (z+zz)*tileSize, float(uu)/uvMod, float(vv)/uvMod,\
-	((float)(x+xx)) / nTiles, ((float)(z+zz)) / nTiles)
-
-	uint n = 0;
-	for(uint z = 0; z < nTiles; ++z)
+	for(uint z = 0; z < width; ++z)
 	{
-		for(uint x = 0; x < nTiles; ++x)
+		for(uint x = 0; x < width; ++x)
 		{
-			int u1 = (x % uvMod);
-			int u2 = ((x + 1) % uvMod);
-			if(u2 == 0)
-				u2 = uvMod;
-			int v1 = (z % uvMod);
-			int v2 = ((z + 1) % uvMod);
-			if(v2 == 0)
-				v2 = uvMod;
-
-			TRI(0, 0, u1, v1);
-			TRI(0, 1, u1, v2);
-			TRI(1, 0, u2, v1);
-			CalculateNormal(v[n - 3], v[n - 2], v[n - 1]);
-
-			TRI(0, 1, u1, v2);
-			TRI(1, 1, u2, v2);
-			TRI(1, 0, u2, v1);
-			CalculateNormal(v[n - 3], v[n - 2], v[n - 1]);
+			v[x + z * width] = VTerrain(x * tileSize, h[x + z * width], z * tileSize, float(x) / uvMod, float(z) / uvMod,
+				float(x) / nTiles, float(z) / nTiles);
 		}
 	}
-#undef TRI
 
-	// fill indices
-	Buf buf;
-	uint size = sizeof(int) * nTris * 3;
-	uint* idx = buf.Get<uint>(size);
-	for(uint z = 0; z < nParts; ++z)
+	// fill index patterns for every lod, shared by all parts (drawn with first vertex of part as base)
+	vector<uint> indices;
+	lodPatterns.resize(lodCount * LOD_EDGE_VARIANTS);
+	for(uint lod = 0; lod < lodCount; ++lod)
 	{
-		for(uint x = 0; x < nParts; ++x)
+		for(int edges = 0; edges < LOD_EDGE_VARIANTS; ++edges)
 		{
-			const uint zStart = z * tilesPerPart,
-				zEnd = zStart + tilesPerPart,
-				xStart = x * tilesPerPart,
-				xEnd = xStart + tilesPerPart;
-
-			for(uint zz = zStart; zz < zEnd; ++zz)
-			{
-				for(uint xx = xStart; xx < xEnd; ++xx)
-				{
-					for(uint j = 0; j < 6; ++j)
-					{
-						*idx = (xx + zz * nTiles) * 6 + j;
-						++idx;
-					}
-				}
-			}
+			LodPattern& pattern = lodPatterns[lod * LOD_EDGE_VARIANTS + edges];
+			pattern.start = (uint)indices.size();
+			FillLodIndices(tilesPerPart, width, lod, lod + 1 < lodCount ? edges : 0, indices);
+			pattern.count = (uint)indices.size() - pattern.start;
 		}
 	}
 
+	Buf buf;
+	const uint indexSize = (smallIndices ? sizeof(word) : sizeof(uint));
+	const uint size = indexSize * (uint)indices.size();
+	if(smallIndices)
+	{
+		word* idx = buf.Get<word>(size);
+		for(uint index : indices)
+			*idx++ = (word)index;
+	}
+	else
+		memcpy(buf.Get<uint>(size), indices.data(), size);
+
 	// create index buffer
 	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-	bufferDesc.ByteWidth = sizeof(int) * nTris * 3;
+	bufferDesc.ByteWidth = size;
 	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	bufferDesc.CPUAccessFlags = 0;
 	bufferDesc.MiscFlags = 0;
@@ -186,14 +160,54 @@ void Terrain::Build(bool smooth)
 	V(device->CreateBuffer(&bufferDesc, &subData, &ib));
 	SetDebugName(ib, "TerrainIb");
 
-	// smooth mesh
+	// calculate normals
 	state = 2;
-	if(smooth)
-		SmoothNormals(v);
+	SmoothNormals(v);
 	deviceContext->Unmap(vbStaging, 0);
 	deviceContext->CopyResource(vb, vbStaging);
 }
 
+//=================================================================================================
+void Terrain::FillLodIndices(uint tilesPerPart, uint pitch, uint lod, int edges, vector<uint>& indices)
+{
+	assert(tilesPerPart % (1u << lod) == 0);
+
+	const uint step = 1u << lod,
+		coarseStep = step * 2;
+
+	// vertices on edge next to lower detail part are snapped to its grid so there are no cracks
+	auto getIndex = [&](uint x, uint z)
+	{
+		if(((edges & EDGE_LEFT) && x == 0) || ((edges & EDGE_RIGHT) && x == tilesPerPart))
+			z = z / coarseStep * coarseStep;
+		if(((edges & EDGE_BOTTOM) && z == 0) || ((edges & EDGE_TOP) && z == tilesPerPart))
+			x = x / coarseStep * coarseStep;
+		return x + z * pitch;
+	};
+	auto addTri = [&](uint a, uint b, uint c)
+	{
+		if(a != b && b != c && a != c)
+		{
+			indices.push_back(a);
+			indices.push_back(b);
+			indices.push_back(c);
+		}
+	};
+
+	for(uint z = 0; z < tilesPerPart; z += step)
+	{
+		for(uint x = 0; x < tilesPerPart; x += step)
+		{
+			const uint i00 = getIndex(x, z),
+				i10 = getIndex(x + step, z),
+				i01 = getIndex(x, z + step),
+				i11 = getIndex(x + step, z + step);
+			addTri(i00, i01, i10);
+			addTri(i01, i11, i10);
+		}
+	}
+}
+
 //=================================================================================================
 void Terrain::Rebuild(bool smooth)
 {
@@ -204,31 +218,92 @@ void Terrain::Rebuild(bool smooth)
 	V(deviceContext->Map(vbStaging, 0, D3D11_MAP_READ_WRITE, 0, &res));
 	VTerrain* v = reinterpret_cast<VTerrain*>(res.pData);
 
-#define TRI(xx,zz) v[n++].pos.y = h[x+xx+(z+zz)*width]
+	for(uint i = 0; i < width2; ++i)
+		v[i].pos.y = h[i];
+	SmoothNormals(v);
 
-	uint n = 0;
-	for(uint z = 0; z < nTiles; ++z)
+	deviceContext->Unmap(vbStaging, 0);
+	deviceContext->CopyResource(vb, vbStaging);
+}
+
+//=================================================================================================
+void Terrain::MarkDirty(const Rect& tiles)
+{
+	assert(state > 0);
+
+	if(dirty)
+		dirtyTiles.Resize(tiles);
+	else
 	{
-		for(uint x = 0; x < nTiles; ++x)
-		{
-			TRI(0, 0);
-			TRI(0, 1);
-			TRI(1, 0);
-			CalculateNormal(v[n - 3], v[n - 2], v[n - 1]);
-
-			TRI(0, 1);
-			TRI(1, 1);
-			TRI(1, 0);
-			CalculateNormal(v[n - 3], v[n - 2], v[n - 1]);
-		}
+		dirtyTiles = tiles;
+		dirty = true;
+	}
+}
+
+//=================================================================================================
+void Terrain::RebuildDirty()
+{
+	assert(state == 2);
+
+	if(!dirty)
+		return;
+	dirty = false;
+
+	const int x1 = max(dirtyTiles.p1.x, 0),
+		z1 = max(dirtyTiles.p1.y, 0),
+		x2 = min(dirtyTiles.p2.x, (int)nTiles),
+		z2 = min(dirtyTiles.p2.y, (int)nTiles);
+	if(x1 >= x2 || z1 >= z2)
+		return;
+
+	// update bounds of parts containing points of dirty tiles
+	const uint partX1 = uint(max(x1 - 1, 0)) / tilesPerPart,
+		partZ1 = uint(max(z1 - 1, 0)) / tilesPerPart,
+		partX2 = min(uint(x2) / tilesPerPart, nParts - 1),
+		partZ2 = min(uint(z2) / tilesPerPart, nParts - 1);
+	for(uint z = partZ1; z <= partZ2; ++z)
+	{
+		for(uint x = partX1; x <= partX2; ++x)
+			CalculatePartBox(x + z * nParts);
 	}
-#undef TRI
+	CalculateTotalBox();
+
+	// points of dirty tiles changed height, one point border around them changed normal
+	const Rect points(max(x1 - 1, 0), max(z1 - 1, 0), min(x2 + 2, (int)width), min(z2 + 2, (int)width));
+
+	ID3D11DeviceContext* deviceContext = app::render->GetDeviceContext();
+	D3D11_MAPPED_SUBRESOURCE res;
+	V(deviceContext->Map(vbStaging, 0, D3D11_MAP_READ_WRITE, 0, &res));
+	VTerrain* v = reinterpret_cast<VTerrain*>(res.pData);
 
-	if(smooth)
-		SmoothNormals(v);
+	for(int z = points.p1.y; z < points.p2.y; ++z)
+	{
+		for(int x = points.p1.x; x < points.p2.x; ++x)
+			v[x + z * width].pos.y = h[x + z * width];
+	}
+	CalculateNormals(v, points);
 
 	deviceContext->Unmap(vbStaging, 0);
-	deviceContext->CopyResource(vb, vbStaging);
+
+	// copy only changed rows, when they span whole width they are continuous
+	D3D11_BOX region = {};
+	region.bottom = 1;
+	region.back = 1;
+	if(points.SizeX() == (int)width)
+	{
+		region.left = sizeof(VTerrain) * points.p1.y * width;
+		region.right = sizeof(VTerrain) * points.p2.y * width;
+		deviceContext->CopySubresourceRegion(vb, 0, region.left, 0, 0, vbStaging, 0, &region);
+	}
+	else
+	{
+		for(int z = points.p1.y; z < points.p2.y; ++z)
+		{
+			region.left = sizeof(VTerrain) * (points.p1.x + z * width);
+			region.right = sizeof(VTerrain) * (points.p2.x + z * width);
+			deviceContext->CopySubresourceRegion(vb, 0, region.left, 0, 0, vbStaging, 0, &region);
+		}
+	}
 }
 
 //=================================================================================================
@@ -241,32 +316,11 @@ void Terrain::RebuildUv()
 	V(deviceContext->Map(vbStaging, 0, D3D11_MAP_READ_WRITE, 0, &res));
 	VTerrain* v = reinterpret_cast<VTerrain*>(res.pData);
 
-#define TRI(uu,vv) v[n++].tex = Vec2(float(uu)/uvMod, float(vv)/uvMod)
-
-	uint n = 0;
-	for(uint z = 0; z < nTiles; ++z)
+	for(uint z = 0; z < width; ++z)
 	{
-		for(uint x = 0; x < nTiles; ++x)
-		{
-			int u1 = (x % uvMod);
-			int u2 = ((x + 1) % uvMod);
-			if(u2 == 0)
-				u2 = uvMod;
-			int v1 = (z % uvMod);
-			int v2 = ((z + 1) % uvMod);
-			if(v2 == 0)
-				v2 = uvMod;
-
-			TRI(u1, v1);
-			TRI(u1, v2);
-			TRI(u2, v1);
-
-			TRI(u1, v2);
-			TRI(u2, v2);
-			TRI(u2, v1);
-		}
+		for(uint x = 0; x < width; ++x)
+			v[x + z * width].tex = Vec2(float(x) / uvMod, float(z) / uvMod);
 	}
-#undef TRI
 
 	deviceContext->Unmap(vbStaging, 0);
 	deviceContext->CopyResource(vb, vbStaging);
@@ -298,6 +352,8 @@ void Terrain::SetHeight(float height)
 		parts[i].box.v1.y = height - 0.1f;
 		parts[i].box.v2.y = height + 0.1f;
 	}
+	std::fill(lodErrors.begin(), lodErrors.end(), 0.f);
+	CalculateQuadTreeHeight(quadTree.top);
 }
 
 //=================================================================================================
@@ -396,44 +452,131 @@ void Terrain::CalculateBox()
 {
 	assert(state > 0);
 
-	float smax = -Inf(),
-		smin = Inf();
-	for(uint i = 0; i < nParts * nParts; ++i)
+	for(uint i = 0; i < nParts2; ++i)
+		CalculatePartBox(i);
+	CalculateTotalBox();
+}
+
+//=================================================================================================
+void Terrain::CalculatePartBox(uint index)
+{
+	float pmax = -Inf();
+	float pmin = Inf();
+
+	const uint zStart = (index / nParts) * tilesPerPart,
+		zEnd = zStart + tilesPerPart,
+		xStart = (index % nParts) * tilesPerPart,
+		xEnd = xStart + tilesPerPart;
+
+	for(uint z = zStart; z <= zEnd; ++z)
 	{
-		float pmax = -Inf();
-		float pmin = Inf();
+		for(uint x = xStart; x <= xEnd; ++x)
+		{
+			float hc = h[x + z * width];
+			if(hc > pmax)
+				pmax = hc;
+			if(hc < pmin)
+				pmin = hc;
+		}
+	}
+
+	parts[index].box.v1.y = pmin - 0.1f;
+	parts[index].box.v2.y = pmax + 0.1f;
 
-		const uint zStart = (i / nParts) * tilesPerPart,
-			zEnd = zStart + tilesPerPart,
-			xStart = (i % nParts) * tilesPerPart,
-			xEnd = xStart + tilesPerPart;
+	CalculateLodErrors(index);
+}
+
+//=================================================================================================
+void Terrain::CalculateLodErrors(uint index)
+{
+	const uint xStart = (index % nParts) * tilesPerPart,
+		zStart = (index / nParts) * tilesPerPart;
+	float* errors = &lodErrors[index * lodCount];
 
-		for(uint z = zStart; z <= zEnd; ++z)
+#define HP(xx,zz) h[xStart+(xx)+(zStart+(zz))*width]
+
+	// max height difference between full detail points and surface of lower detail mesh
+	errors[0] = 0.f;
+	for(uint lod = 1; lod < lodCount; ++lod)
+	{
+		const uint step = 1u << lod;
+		const float invStep = 1.f / step;
+		float error = errors[lod - 1];
+		for(uint z = 0; z <= tilesPerPart; ++z)
 		{
-			for(uint x = xStart; x <= xEnd; ++x)
+			const uint cz = min(z / step * step, tilesPerPart - step);
+			const float fz = (z - cz) * invStep;
+			for(uint x = 0; x <= tilesPerPart; ++x)
 			{
-				float hc = h[x + z * width];
-				if(hc > pmax)
-					pmax = hc;
-				if(hc < pmin)
-					pmin = hc;
+				const uint cx = min(x / step * step, tilesPerPart - step);
+				const float fx = (x - cx) * invStep;
+				const float h00 = HP(cx, cz),
+					h10 = HP(cx + step, cz),
+					h01 = HP(cx, cz + step),
+					h11 = HP(cx + step, cz + step);
+				float hc;
+				if(fx + fz <= 1.f)
+					hc = h00 + (h10 - h00) * fx + (h01 - h00) * fz;
+				else
+					hc = h11 + (h01 - h11) * (1.f - fx) + (h10 - h11) * (1.f - fz);
+				error = max(error, abs(HP(x, z) - hc));
 			}
 		}
+		errors[lod] = error;
+	}
 
-		pmin -= 0.1f;
-		pmax += 0.1f;
-
-		parts[i].box.v1.y = pmin;
-		parts[i].box.v2.y = pmax;
+#undef HP
+}
 
-		if(pmax > smax)
-			smax = pmax;
-		if(pmin < smin)
-			smin = pmin;
+//=================================================================================================
+void Terrain::CalculateTotalBox()
+{
+	float smax = -Inf(),
+		smin = Inf();
+	for(uint i = 0; i < nParts2; ++i)
+	{
+		const Box& partBox = parts[i].box;
+		if(partBox.v2.y > smax)
+			smax = partBox.v2.y;
+		if(partBox.v1.y < smin)
+			smin = partBox.v1.y;
 	}
 
 	box.v1.y = smin;
 	box.v2.y = smax;
+	CalculateQuadTreeHeight(quadTree.top);
+}
+
+//=================================================================================================
+void Terrain::CalculateQuadTreeHeight(QuadNode* node)
+{
+	node->minY = Inf();
+	node->maxY = -Inf();
+	if(node->leaf)
+	{
+		const Rect& grid = node->gridBox;
+		for(int z = grid.p1.y; z < grid.p2.y; ++z)
+		{
+			for(int x = grid.p1.x; x < grid.p2.x; ++x)
+			{
+				const Box& partBox = parts[x + z * nParts].box;
+				node->minY = min(node->minY, partBox.v1.y);
+				node->maxY = max(node->maxY, partBox.v2.y);
+			}
+		}
+	}
+	else
+	{
+		for(QuadNode* child : node->childs)
+		{
+			if(child)
+			{
+				CalculateQuadTreeHeight(child);
+				node->minY = min(node->minY, child->minY);
+				node->maxY = max(node->maxY, child->maxY);
+			}
+		}
+	}
 }
 
 //=================================================================================================
@@ -470,148 +613,181 @@ void Terrain::SmoothNormals(VTerrain* v)
 	assert(state > 0);
 	assert(v);
 
-	Vec3 normal, normal2;
-	uint sum;
-
-	// 1,3         4
-	//(0,1)		 (1,1)
-	// O-----------O
-	// |\          |
-	// |  \        |
-	// |    \      |
-	// |      \    |
-	// |        \  |
-	// |          \|
-	// O-----------O
-	//(0,0)		 (1,0)
-	//  0         2,5
-
-#undef W
-#define W(xx,zz,idx) v[(x+(xx)+(z+(zz))*nTiles)*6+(idx)]
-#define CalcNormal(xx,zz,i0,i1,i2) CalculateNormal(normal2,W(xx,zz,i0).pos,W(xx,zz,i1).pos,W(xx,zz,i2).pos);\
-	normal += normal2
-
-	// wygad normalne
-	for(uint z = 0; z < nTiles; ++z)
+	CalculateNormals(v, Rect(0, 0, width, width));
+}
+
+//=================================================================================================
+void Terrain::CalculateNormals(VTerrain* v, const Rect& points)
+{
+	// normal from height differences of neighbour points (one sided on borders)
+	for(uint z = points.p1.y; z < (uint)points.p2.y; ++z)
 	{
-		for(uint x = 0; x < nTiles; ++x)
+		const uint z1 = (z > 0 ? z - 1 : z),
+			z2 = (z < width - 1 ? z + 1 : z);
+		for(uint x = points.p1.x; x < (uint)points.p2.x; ++x)
 		{
-			bool hasLeft = (x > 0),
-				hasRight = (x < nTiles - 1),
-				hasBottom = (z > 0),
-				hasTop = (z < nTiles - 1);
-
-			//------------------------------------------
-			// PUNKT (0,0)
-			sum = 1;
-			normal = W(0, 0, 0).normal;
-
-			if(hasLeft)
-			{
-				CalcNormal(-1, 0, 0, 1, 2);
-				CalcNormal(-1, 0, 3, 4, 5);
-				sum += 2;
-
-				if(hasBottom)
-				{
-					CalcNormal(-1, -1, 3, 4, 5);
-					++sum;
-				}
-			}
-			if(hasBottom)
-			{
-				CalcNormal(0, -1, 0, 1, 2);
-				CalcNormal(0, -1, 3, 4, 5);
-				sum += 2;
-			}
-
-			normal *= (1.f / sum);
-			W(0, 0, 0).normal = normal;
+			const uint x1 = (x > 0 ? x - 1 : x),
+				x2 = (x < width - 1 ? x + 1 : x);
+			const float dx = (h[x2 + z * width] - h[x1 + z * width]) / ((x2 - x1) * tileSize);
+			const float dz = (h[x + z2 * width] - h[x + z1 * width]) / ((z2 - z1) * tileSize);
+			const Vec3 normal = Vec3(-dx, 1.f, -dz).Normalize();
+			if(v)
+				v[x + z * width].normal = normal;
+			if(!normalMap.empty())
+				normalMap[x + z * width] = normal;
+		}
+	}
+}
 
-			//------------------------------------------
-			// PUNKT (0,1)
-			normal = W(0, 0, 1).normal;
-			normal += W(0, 0, 3).normal;
-			sum = 2;
+//=================================================================================================
+void Terrain::BuildNormalMap()
+{
+	assert(state > 0);
 
-			if(hasLeft)
-			{
-				CalcNormal(-1, 0, 3, 4, 5);
-				++sum;
+	normalMap.resize(width2);
+	CalculateNormals(nullptr, Rect(0, 0, width, width));
+}
 
-				if(hasTop)
-				{
-					CalcNormal(-1, 1, 0, 1, 2);
-					CalcNormal(-1, 1, 3, 4, 5);
-					sum += 2;
-				}
-			}
-			if(hasTop)
-			{
-				CalcNormal(0, 1, 0, 1, 2);
-				++sum;
-			}
+//=================================================================================================
+void Terrain::GetTiles4(const Vec2* in, XMVECTOR& ox, XMVECTOR& oz, XMVECTOR* corners) const
+{
+	assert(IsInside(in[0]) && IsInside(in[1]) && IsInside(in[2]) && IsInside(in[3]));
+
+	const __m128 inv = _mm_set1_ps(invTileSize);
+	const __m128 fx = _mm_mul_ps(_mm_sub_ps(_mm_set_ps(in[3].x, in[2].x, in[1].x, in[0].x), _mm_set1_ps(pos.x)), inv);
+	const __m128 fz = _mm_mul_ps(_mm_sub_ps(_mm_set_ps(in[3].y, in[2].y, in[1].y, in[0].y), _mm_set1_ps(pos.z)), inv);
+
+	// points are inside so truncation works as floor, point on far edge belongs to last tile
+	const __m128i maxTile = _mm_set1_epi32(nTiles - 1);
+	__m128i tx = _mm_cvttps_epi32(fx);
+	__m128i tz = _mm_cvttps_epi32(fz);
+	tx = _mm_add_epi32(tx, _mm_cmpgt_epi32(tx, maxTile));
+	tz = _mm_add_epi32(tz, _mm_cmpgt_epi32(tz, maxTile));
+	ox = _mm_sub_ps(fx, _mm_cvtepi32_ps(tx));
+	oz = _mm_sub_ps(fz, _mm_cvtepi32_ps(tz));
+
+	// no gather in SSE, load corner heights one by one
+	alignas(16) int ix[4], iz[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(ix), tx);
+	_mm_store_si128(reinterpret_cast<__m128i*>(iz), tz);
+	alignas(16) float hc[4][4];
+	for(int i = 0; i < 4; ++i)
+	{
+		const uint index = ix[i] + iz[i] * width;
+		hc[CORNER_BOTTOM_LEFT][i] = h[index];
+		hc[CORNER_BOTTOM_RIGHT][i] = h[index + 1];
+		hc[CORNER_TOP_LEFT][i] = h[index + width];
+		hc[CORNER_TOP_RIGHT][i] = h[index + width + 1];
+	}
+	for(int i = 0; i < 4; ++i)
+		corners[i] = _mm_load_ps(hc[i]);
+}
 
-			normal *= (1.f / sum);
-			W(0, 0, 1).normal = normal;
-			W(0, 0, 3).normal = normal;
+//=================================================================================================
+void Terrain::GetH(const Vec2* in, float* out, uint count) const
+{
+	assert(state > 0);
+	assert(in && out);
 
-			//------------------------------------------
-			// PUNKT (1,0)
-			normal = W(0, 0, 2).normal;
-			normal += W(0, 0, 5).normal;
-			sum = 2;
+	const __m128 one = _mm_set1_ps(1.f);
+	uint i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		XMVECTOR ox, oz, c[4];
+		GetTiles4(in + i, ox, oz, c);
+
+		const __m128 lower = _mm_add_ps(c[CORNER_BOTTOM_LEFT], _mm_add_ps(
+			_mm_mul_ps(_mm_sub_ps(c[CORNER_BOTTOM_RIGHT], c[CORNER_BOTTOM_LEFT]), ox),
+			_mm_mul_ps(_mm_sub_ps(c[CORNER_TOP_LEFT], c[CORNER_BOTTOM_LEFT]), oz)));
+		const __m128 upper = _mm_add_ps(c[CORNER_TOP_RIGHT], _mm_add_ps(
+			_mm_mul_ps(_mm_sub_ps(c[CORNER_TOP_LEFT], c[CORNER_TOP_RIGHT]), _mm_sub_ps(one, ox)),
+			_mm_mul_ps(_mm_sub_ps(c[CORNER_BOTTOM_RIGHT], c[CORNER_TOP_RIGHT]), _mm_sub_ps(one, oz))));
+		const __m128 isLower = _mm_cmplt_ps(_mm_add_ps(ox, oz), one);
+		_mm_storeu_ps(out + i, _mm_or_ps(_mm_and_ps(isLower, lower), _mm_andnot_ps(isLower, upper)));
+	}
 
-			if(hasRight)
-			{
-				CalcNormal(1, 0, 0, 1, 2);
-				++sum;
+	for(; i < count; ++i)
+		out[i] = GetH(in[i].x, in[i].y);
+}
 
-				if(hasBottom)
-				{
-					CalcNormal(1, -1, 0, 1, 2);
-					CalcNormal(1, -1, 3, 4, 5);
-					sum += 2;
-				}
-			}
-			if(hasBottom)
-			{
-				CalcNormal(0, -1, 3, 4, 5);
-				++sum;
-			}
+//=================================================================================================
+Vec3 Terrain::GetNormal(float x, float z) const
+{
+	assert(state > 0);
+	assert(IsInside(x, z));
 
-			normal *= (1.f / sum);
-			W(0, 0, 2).normal = normal;
-			W(0, 0, 5).normal = normal;
+	const float fx = (x - pos.x) * invTileSize,
+		fz = (z - pos.z) * invTileSize;
+	const uint tx = min((uint)fx, nTiles - 1),
+		tz = min((uint)fz, nTiles - 1);
+	const float offsetx = fx - tx,
+		offsetz = fz - tz;
+	const uint index = tx + tz * width;
 
-			//------------------------------------------
-			// PUNKT (1,1)
-			normal = W(0, 0, 4).normal;
-			sum = 1;
+	if(!normalMap.empty())
+	{
+		const Vec3 bottom = Vec3::Lerp(normalMap[index], normalMap[index + 1], offsetx);
+		const Vec3 top = Vec3::Lerp(normalMap[index + width], normalMap[index + width + 1], offsetx);
+		return Vec3::Lerp(bottom, top, offsetz).Normalize();
+	}
 
-			if(hasRight)
-			{
-				CalcNormal(1, 0, 0, 1, 2);
-				CalcNormal(1, 0, 3, 4, 5);
-				sum += 2;
+	// normal of triangle
+	const float hBottomLeft = h[index],
+		hBottomRight = h[index + 1],
+		hTopLeft = h[index + width],
+		hTopRight = h[index + width + 1];
+	float dx, dz;
+	if(offsetx + offsetz < 1.f)
+	{
+		dx = hBottomRight - hBottomLeft;
+		dz = hTopLeft - hBottomLeft;
+	}
+	else
+	{
+		dx = hTopRight - hTopLeft;
+		dz = hTopRight - hBottomRight;
+	}
+	return Vec3(-dx * invTileSize, 1.f, -dz * invTileSize).Normalize();
+}
 
-				if(hasTop)
-				{
-					CalcNormal(1, 1, 0, 1, 2);
-					++sum;
-				}
-			}
-			if(hasTop)
-			{
-				CalcNormal(0, 1, 0, 1, 2);
-				CalcNormal(0, 1, 3, 4, 5);
-				sum += 2;
-			}
+//=================================================================================================
+void Terrain::GetNormal(const Vec2* in, Vec3* out, uint count) const
+{
+	assert(state > 0);
+	assert(in && out);
 
-			normal *= (1.f / sum);
-			W(0, 0, 4).normal = normal;
+	uint i = 0;
+	if(normalMap.empty())
+	{
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 inv = _mm_set1_ps(invTileSize);
+		for(; i + 4 <= count; i += 4)
+		{
+			XMVECTOR ox, oz, c[4];
+			GetTiles4(in + i, ox, oz, c);
+
+			// slope of triangle containing point
+			const __m128 isLower = _mm_cmplt_ps(_mm_add_ps(ox, oz), one);
+			const __m128 lowerDx = _mm_sub_ps(c[CORNER_BOTTOM_RIGHT], c[CORNER_BOTTOM_LEFT]),
+				lowerDz = _mm_sub_ps(c[CORNER_TOP_LEFT], c[CORNER_BOTTOM_LEFT]),
+				upperDx = _mm_sub_ps(c[CORNER_TOP_RIGHT], c[CORNER_TOP_LEFT]),
+				upperDz = _mm_sub_ps(c[CORNER_TOP_RIGHT], c[CORNER_BOTTOM_RIGHT]);
+			const __m128 dx = _mm_mul_ps(_mm_or_ps(_mm_and_ps(isLower, lowerDx), _mm_andnot_ps(isLower, upperDx)), inv),
+				dz = _mm_mul_ps(_mm_or_ps(_mm_and_ps(isLower, lowerDz), _mm_andnot_ps(isLower, upperDz)), inv);
+
+			// normalize (-dx, 1, -dz)
+			const __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)), one)));
+			alignas(16) float nx[4], ny[4], nz[4];
+			_mm_store_ps(nx, _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), dx), invLength));
+			_mm_store_ps(ny, invLength);
+			_mm_store_ps(nz, _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), dz), invLength));
+			for(int j = 0; j < 4; ++j)
+				out[i + j] = Vec3(nx[j], ny[j], nz[j]);
 		}
 	}
+
+	for(; i < count; ++i)
+		out[i] = GetNormal(in[i].x, in[i].y);
 }
 
 //=================================================================================================
@@ -622,8 +798,8 @@ float Terrain::GetH(float x, float z) const
 
 	// oblicz ktre to kafle
 	uint tx, tz;
-	tx = (uint)floor((x - pos.x) / tileSize);
-	tz = (uint)floor((z - pos.z) / tileSize);
+	tx = (uint)floor((x - pos.x) * invTileSize);
+	tz = (uint)floor((z - pos.z) * invTileSize);
 
 	// sprawd czy nie jest to poza terenem
 	// teren na samej krawdzi wykrywa jako bd
@@ -634,8 +810,8 @@ float Terrain::GetH(float x, float z) const
 
 	// oblicz offset od kafla do punktu
 	float offsetx, offsetz;
-	offsetx = ((x - pos.x) - tileSize * tx) / tileSize;
-	offsetz = ((z - pos.z) - tileSize * tz) / tileSize;
+	offsetx = (x - pos.x) * invTileSize - tx;
+	offsetz = (z - pos.z) * invTileSize - tz;
 
 	// pobierz wysokoci na krawdziach
 	float hTopLeft = h[tx + (tz + 1) * width];
@@ -644,7 +820,7 @@ float Terrain::GetH(float x, float z) const
 	float hBottomRight = h[tx + 1 + tz * width];
 
 	// sprawd ktry to trjkt (prawy grny czy lewy dolny)
-	if((offsetx * offsetx + offsetz * offsetz) < ((1 - offsetx) * (1 - offsetx) + (1 - offsetz) * (1 - offsetz)))
+	if(offsetx + offsetz < 1.f)
 	{
 		// lewy dolny trjkt
 		float dX = hBottomRight - hBottomLeft;
@@ -665,10 +841,16 @@ void Terrain::GetAngle(float x, float z, Vec3& angle) const
 {
 	assert(IsInside(x, z));
 
+	if(!normalMap.empty())
+	{
+		angle = GetNormal(x, z);
+		return;
+	}
+
 	// oblicz ktre to kafle
 	uint tx, tz;
-	tx = (uint)floor((x - pos.x) / tileSize);
-	tz = (uint)floor((z - pos.z) / tileSize);
+	tx = (uint)floor((x - pos.x) * invTileSize);
+	tz = (uint)floor((z - pos.z) * invTileSize);
 
 	// sprawd czy nie jest to poza terenem
 	// teren na samej krawdzi wykrywa jako bd
@@ -679,8 +861,8 @@ void Terrain::GetAngle(float x, float z, Vec3& angle) const
 
 	// oblicz offset od kafla do punktu
 	float offsetx, offsetz;
-	offsetx = ((x - pos.x) - tileSize * tx) / tileSize;
-	offsetz = ((z - pos.z) - tileSize * tz) / tileSize;
+	offsetx = (x - pos.x) * invTileSize - tx;
+	offsetz = (z - pos.z) * invTileSize - tz;
 
 	// pobierz wysokoci na krawdziach
 	float hTopLeft = h[tx + (tz + 1) * width];
@@ -714,12 +896,11 @@ void Terrain::GetAngle(float x, float z, Vec3& angle) const
 //=================================================================================================
 void Terrain::FillGeometry(vector<Tri>& tris, vector<Vec3>& verts)
 {
-	uint vcount = (nTiles + 1) * (nTiles + 1);
-	verts.reserve(vcount);
+	verts.reserve(width2);
 
-	for(uint z = 0; z <= (nTiles + 1); ++z)
+	for(uint z = 0; z < width; ++z)
 	{
-		for(uint x = 0; x <= (nTiles + 1); ++x)
+		for(uint x = 0; x < width; ++x)
 		{
 			verts.push_back(Vec3(x * tileSize, h[x + z * width], z * tileSize));
 		}
@@ -727,7 +908,7 @@ void Terrain::FillGeometry(vector<Tri>& tris, vector<Vec3>& verts)
 
 	tris.reserve(nTiles * nTiles * 3);
 
-#define XZ(xx,zz) (x+(xx)+(z+(zz))*(nTiles+1))
+#define XZ(xx,zz) (x+(xx)+(z+(zz))*width)
 
 	for(uint z = 0; z < nTiles; ++z)
 	{
@@ -809,14 +990,134 @@ bool Terrain::IsInside(float x, float z) const
 }
 
 //=================================================================================================
-void Terrain::ListVisibleParts(vector<uint>& outParts, const FrustumPlanes& frustum) const
+void Terrain::ListVisibleParts(vector<TerrainPartLod>& outParts, const FrustumPlanes& frustum, const Vec3& cameraPos) const
+{
+	if(!frustum.BoxToFrustum(box))
+		return;
+
+	quadTree.ListLeafs(frustum, visibleNodes);
+	visibleParts.clear();
+	candidateParts.clear();
+	partBoxes.Clear();
+	for(QuadNode* node : visibleNodes)
+	{
+		// leaf with single part was already tested, rest is tested in batch
+		const Rect& grid = node->gridBox;
+		if(grid.SizeX() == 1 && grid.SizeY() == 1)
+		{
+			visibleParts.push_back(grid.p1.x + grid.p1.y * nParts);
+			continue;
+		}
+		for(int z = grid.p1.y; z < grid.p2.y; ++z)
+		{
+			for(int x = grid.p1.x; x < grid.p2.x; ++x)
+			{
+				const uint index = x + z * nParts;
+				candidateParts.push_back(index);
+				partBoxes.Add(parts[index].box);
+			}
+		}
+	}
+
+	partBoxes.Test(frustum);
+	for(uint i = 0, count = partBoxes.Size(); i < count; ++i)
+	{
+		if(partBoxes.IsVisible(i))
+			visibleParts.push_back(candidateParts[i]);
+	}
+	if(visibleParts.empty())
+		return;
+
+	// lods are only needed for visible parts and their neighbours (for edges)
+	Rect area(nParts, nParts, 0, 0);
+	for(uint index : visibleParts)
+	{
+		const int x = index % nParts,
+			z = index / nParts;
+		area.p1.x = min(area.p1.x, x - 1);
+		area.p1.y = min(area.p1.y, z - 1);
+		area.p2.x = max(area.p2.x, x + 2);
+		area.p2.y = max(area.p2.y, z + 2);
+	}
+	area.p1.x = max(area.p1.x, 0);
+	area.p1.y = max(area.p1.y, 0);
+	area.p2.x = min(area.p2.x, (int)nParts);
+	area.p2.y = min(area.p2.y, (int)nParts);
+	SelectLods(cameraPos, area);
+
+	for(uint index : visibleParts)
+		outParts.push_back(GetPartLod(index));
+}
+
+//=================================================================================================
+inline float DistanceToBox(const Box& box, const Vec3& pt)
 {
-	if(frustum.BoxToFrustum(box))
+	const Vec3 closest(Clamp(pt.x, box.v1.x, box.v2.x), Clamp(pt.y, box.v1.y, box.v2.y), Clamp(pt.z, box.v1.z, box.v2.z));
+	return Vec3::Distance(closest, pt);
+}
+
+//=================================================================================================
+void Terrain::SelectLods(const Vec3& cameraPos, const Rect& area) const
+{
+	// lowest detail with error small enough for distance
+	partLods.resize(nParts2);
+	for(int z = area.p1.y; z < area.p2.y; ++z)
 	{
-		for(uint i = 0; i < nParts2; ++i)
+		for(int x = area.p1.x; x < area.p2.x; ++x)
 		{
-			if(frustum.BoxToFrustum(parts[i].box))
-				outParts.push_back(i);
+			const uint index = x + z * nParts;
+			const float maxError = DistanceToBox(parts[index].box, cameraPos) * lodTolerance;
+			const float* errors = &lodErrors[index * lodCount];
+			uint lod = 0;
+			while(lod + 1 < lodCount && errors[lod + 1] <= maxError)
+				++lod;
+			partLods[index] = (byte)lod;
 		}
 	}
+
+	// neighbour parts can differ by at most one level so edges can be stitched
+	bool changed = true;
+	while(changed)
+	{
+		changed = false;
+		for(int z = area.p1.y; z < area.p2.y; ++z)
+		{
+			for(int x = area.p1.x; x < area.p2.x; ++x)
+			{
+				const uint index = x + z * nParts;
+				byte minLod = partLods[index];
+				if(x > area.p1.x)
+					minLod = min(minLod, partLods[index - 1]);
+				if(x < area.p2.x - 1)
+					minLod = min(minLod, partLods[index + 1]);
+				if(z > area.p1.y)
+					minLod = min(minLod, partLods[index - nParts]);
+				if(z < area.p2.y - 1)
+					minLod = min(minLod, partLods[index + nParts]);
+				if(partLods[index] > minLod + 1)
+				{
+					partLods[index] = byte(minLod + 1);
+					changed = true;
+				}
+			}
+		}
+	}
+}
+
+//=================================================================================================
+TerrainPartLod Terrain::GetPartLod(uint index) const
+{
+	const uint x = index % nParts,
+		z = index / nParts;
+	const byte lod = partLods[index];
+	int edges = 0;
+	if(x > 0 && partLods[index - 1] > lod)
+		edges |= EDGE_LEFT;
+	if(x < nParts - 1 && partLods[index + 1] > lod)
+		edges |= EDGE_RIGHT;
+	if(z > 0 && partLods[index - nParts] > lod)
+		edges |= EDGE_BOTTOM;
+	if(z < nParts - 1 && partLods[index + nParts] > lod)
+		edges |= EDGE_TOP;
+	return { index, lod, edges };
 }
@@ -6,6 +6,7 @@
 #include "Render.h"
 #include "Scene.h"
 #include "SceneManager.h"
+#include "SceneNode.h"
 #include "Terrain.h"
 #include "Texture.h"
 
@@ -92,14 +93,14 @@ void TerrainShader::Prepare(Scene* scene, Camera* camera)
 }
 
 //=================================================================================================
-void TerrainShader::Draw(Terrain* terrain, const vector<uint>& parts)
+void TerrainShader::Draw(Terrain* terrain, const vector<TerrainPartLod>& parts)
 {
 	assert(terrain);
 
 	// setup shader
 	uint stride = sizeof(VTerrain), offset = 0;
 	deviceContext->IASetVertexBuffers(0, 1, &terrain->vb, &stride, &offset);
-	deviceContext->IASetIndexBuffer(terrain->ib, DXGI_FORMAT_R32_UINT, 0);
+	deviceContext->IASetIndexBuffer(terrain->ib, terrain->smallIndices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, 0);
 
 	// vertex shader constants
 	{
@@ -119,6 +120,11 @@ void TerrainShader::Draw(Terrain* terrain, const vector<uint>& parts)
 	deviceContext->PSSetShaderResources(0, 6, textures);
 
 	// draw
-	for(uint part : parts)
-		deviceContext->DrawIndexed(terrain->partTris * 3, terrain->partTris * part * 3, 0);
+	for(const TerrainPartLod& part : parts)
+	{
+		const Terrain::LodPattern& pattern = terrain->lodPatterns[part.lod * Terrain::LOD_EDGE_VARIANTS + part.edges];
+		const uint x = part.index % terrain->nParts,
+			z = part.index / terrain->nParts;
+		deviceContext->DrawIndexed(pattern.count, pattern.start, (x + z * terrain->width) * terrain->tilesPerPart);
+	}
 }
@@ -1,4 +1,5 @@
 #include "Pch.h"
+#include <charconv>
 #include <cstdarg>
 #include <sstream>
 // for lstrlenW
@@ -8,6 +9,8 @@ static const uint FORMAT_STRINGS = 8;
 static const uint FORMAT_LENGTH = 2048;
 static thread_local char formatBuf[FORMAT_STRINGS][FORMAT_LENGTH];
 static thread_local int formatMarker;
+static thread_local string formatStrings[FORMAT_STRINGS];
+static thread_local int formatStringMarker;
 static const char ESCAPE_FROM[] = { '\n', '\t', '\r', ' ' };
 static cstring ESCAPE_TO[] = { "\\n", "\\t", "\\r", " " };
 
@@ -20,54 +23,593 @@ char* GetFormatString()
 }
 
 //=================================================================================================
-// Formatowanie cigu znakw
+// Formatting engine
 //=================================================================================================
-cstring Format(cstring str, ...)
+namespace
 {
-	assert(str);
+	struct FormatSpec
+	{
+		int width, precision;
+		char conv;
+		bool left, plus, space, alt, zero;
+	};
 
-	va_list list;
-	va_start(list, str);
-	char* cbuf = GetFormatString();
-	_vsnprintf_s(cbuf, FORMAT_LENGTH, FORMAT_LENGTH - 1, str, list);
-	cbuf[FORMAT_LENGTH - 1] = 0;
-	va_end(list);
+	// Formatting output, appends to string or writes to buffer (truncated but full length is counted)
+	struct FormatSink
+	{
+		explicit FormatSink(string& str) : str(&str), buf(nullptr), size(0), length(0) {}
+		FormatSink(char* buf, uint size) : str(nullptr), buf(buf), size(size), length(0) {}
 
-	return cbuf;
+		void Append(cstring s, uint count)
+		{
+			if(str)
+				str->append(s, count);
+			else if(count != 0 && length < size)
+				memcpy(buf + length, s, std::min(count, size - length));
+			length += count;
+		}
+		void Append(uint count, char c)
+		{
+			if(str)
+				str->append(count, c);
+			else if(length < size)
+				memset(buf + length, c, std::min(count, size - length));
+			length += count;
+		}
+		void Append(char c)
+		{
+			Append(&c, 1);
+		}
+
+		string* str;
+		char* buf;
+		uint size; // without null terminator
+		uint length;
+	};
 }
 
 //=================================================================================================
-cstring FormatList(cstring str, va_list list)
+static string& GetFormatStr()
 {
-	assert(str);
-
-	char* cbuf = GetFormatString();
-	_vsnprintf_s(cbuf, FORMAT_LENGTH, FORMAT_LENGTH - 1, str, list);
-	cbuf[FORMAT_LENGTH - 1] = 0;
+	string& str = formatStrings[formatStringMarker];
+	formatStringMarker = (formatStringMarker + 1) % FORMAT_STRINGS;
+	str.clear();
+	return str;
+}
 
-	return cbuf;
+//=================================================================================================
+static void AppendPadded(FormatSink& out, const FormatSpec& spec, cstring prefix, uint prefixLength, cstring body, uint bodyLength)
+{
+	const uint length = prefixLength + bodyLength;
+	const uint pad = spec.width > (int)length ? spec.width - length : 0;
+	if(pad == 0)
+	{
+		out.Append(prefix, prefixLength);
+		out.Append(body, bodyLength);
+	}
+	else if(spec.left)
+	{
+		out.Append(prefix, prefixLength);
+		out.Append(body, bodyLength);
+		out.Append(pad, ' ');
+	}
+	else if(spec.zero)
+	{
+		out.Append(prefix, prefixLength);
+		out.Append(pad, '0');
+		out.Append(body, bodyLength);
+	}
+	else
+	{
+		out.Append(pad, ' ');
+		out.Append(prefix, prefixLength);
+		out.Append(body, bodyLength);
+	}
 }
 
 //=================================================================================================
-void FormatStr(string& s, cstring str, ...)
+// Use printf for rare cases (%a, '#' for floats)
+static void FormatDoubleFallback(FormatSink& out, const FormatSpec& spec, double value)
 {
-	assert(str);
-	va_list list;
-	va_start(list, str);
-	s.resize(FORMAT_LENGTH);
-	char* cbuf = (char*)s.data();
-	int len = _vsnprintf_s(cbuf, FORMAT_LENGTH, FORMAT_LENGTH - 1, str, list);
-	if(len >= 0)
+	char fmt[16];
+	char* f = fmt;
+	*f++ = '%';
+	if(spec.left)
+		*f++ = '-';
+	if(spec.plus)
+		*f++ = '+';
+	if(spec.space)
+		*f++ = ' ';
+	if(spec.alt)
+		*f++ = '#';
+	if(spec.zero)
+		*f++ = '0';
+	*f++ = '*';
+	if(spec.precision >= 0)
 	{
-		cbuf[len] = 0;
-		s.resize(len);
+		*f++ = '.';
+		*f++ = '*';
 	}
+	*f++ = spec.conv;
+	*f = 0;
+
+	int length;
+	if(spec.precision >= 0)
+		length = _scprintf(fmt, spec.width, spec.precision, value);
 	else
+		length = _scprintf(fmt, spec.width, value);
+	if(length <= 0)
+		return;
+	char* buf;
+	uint size;
+	if(out.str)
 	{
-		cbuf[0] = 0;
-		s.clear();
+		const uint offset = (uint)out.str->length();
+		out.str->resize(offset + length);
+		buf = (char*)out.str->data() + offset;
+		size = length;
+	}
+	else
+	{
+		// truncated to remaining buffer space
+		size = out.length < out.size ? std::min((uint)length, out.size - out.length) : 0;
+		buf = out.buf + out.length;
+	}
+	if(size > 0)
+	{
+		if(spec.precision >= 0)
+			_snprintf_s(buf, size + 1, _TRUNCATE, fmt, spec.width, spec.precision, value);
+		else
+			_snprintf_s(buf, size + 1, _TRUNCATE, fmt, spec.width, value);
+	}
+	out.length += length;
+}
+
+//=================================================================================================
+static void FormatInteger(FormatSink& out, FormatSpec spec, const FormatArg& arg)
+{
+	const bool isSigned = (spec.conv == 'd' || spec.conv == 'i');
+	int64 value;
+	switch(arg.type)
+	{
+	default:
+	case FormatArg::INT:
+	case FormatArg::CHAR:
+		value = isSigned ? arg.i : (int64)(uint)arg.i;
+		break;
+	case FormatArg::UINT:
+		value = isSigned ? (int64)(int)arg.u : (int64)arg.u;
+		break;
+	case FormatArg::INT64:
+	case FormatArg::UINT64:
+		value = arg.i;
+		break;
+	case FormatArg::DOUBLE:
+		value = (int64)arg.d;
+		break;
+	case FormatArg::STRING:
+	case FormatArg::POINTER:
+		value = (int64)(uintptr_t)arg.p;
+		break;
+	}
+
+	const bool negative = isSigned && value < 0;
+	const uint64 absValue = negative ? 0u - (uint64)value : (uint64)value;
+
+	int base = 10;
+	bool upper = false;
+	switch(spec.conv)
+	{
+	case 'x':
+		base = 16;
+		break;
+	case 'X':
+		base = 16;
+		upper = true;
+		break;
+	case 'o':
+		base = 8;
+		break;
+	}
+
+	char buf[96];
+	char* end = std::to_chars(buf, buf + 64, absValue, base).ptr;
+	uint length = (uint)(end - buf);
+	if(upper)
+	{
+		for(char* c = buf; c != end; ++c)
+		{
+			if(*c >= 'a')
+				*c -= 'a' - 'A';
+		}
+	}
+
+	// precision is minimum count of digits
+	if(spec.precision >= 0)
+	{
+		spec.zero = false;
+		if(spec.precision == 0 && absValue == 0)
+			length = 0;
+		else if((uint)spec.precision > length && spec.precision <= 90)
+		{
+			const uint zeros = spec.precision - length;
+			memmove(buf + zeros, buf, length);
+			memset(buf, '0', zeros);
+			length = spec.precision;
+		}
+	}
+
+	char prefix[3];
+	uint prefixLength = 0;
+	if(negative)
+		prefix[prefixLength++] = '-';
+	else if(isSigned && spec.plus)
+		prefix[prefixLength++] = '+';
+	else if(isSigned && spec.space)
+		prefix[prefixLength++] = ' ';
+	if(spec.alt && absValue != 0)
+	{
+		if(base == 16)
+		{
+			prefix[prefixLength++] = '0';
+			prefix[prefixLength++] = spec.conv;
+		}
+		else if(base == 8)
+			prefix[prefixLength++] = '0';
+	}
+
+	AppendPadded(out, spec, prefix, prefixLength, buf, length);
+}
+
+//=================================================================================================
+static void FormatDouble(FormatSink& out, const FormatSpec& spec, double value)
+{
+	std::chars_format format;
+	switch(spec.conv)
+	{
+	case 'f':
+	case 'F':
+		format = std::chars_format::fixed;
+		break;
+	case 'e':
+	case 'E':
+		format = std::chars_format::scientific;
+		break;
+	case 'g':
+	case 'G':
+		format = std::chars_format::general;
+		break;
+	default:
+		FormatDoubleFallback(out, spec, value);
+		return;
+	}
+	if(spec.alt)
+	{
+		FormatDoubleFallback(out, spec, value);
+		return;
+	}
+
+	const bool negative = std::signbit(value);
+	char buf[128];
+	const std::to_chars_result result = std::to_chars(buf, buf + sizeof(buf), negative ? -value : value, format,
+		spec.precision >= 0 ? spec.precision : 6);
+	if(result.ec != std::errc())
+	{
+		FormatDoubleFallback(out, spec, value);
+		return;
+	}
+	if(spec.conv == 'F' || spec.conv == 'E' || spec.conv == 'G')
+	{
+		for(char* c = buf; c != result.ptr; ++c)
+		{
+			if(*c >= 'a' && *c <= 'z')
+				*c -= 'a' - 'A';
+		}
+	}
+
+	char sign = 0;
+	if(negative)
+		sign = '-';
+	else if(spec.plus)
+		sign = '+';
+	else if(spec.space)
+		sign = ' ';
+	FormatSpec spec2 = spec;
+	if(!std::isfinite(value))
+		spec2.zero = false;
+	AppendPadded(out, spec2, &sign, sign ? 1 : 0, buf, (uint)(result.ptr - buf));
+}
+
+//=================================================================================================
+static double ToDouble(const FormatArg& arg)
+{
+	switch(arg.type)
+	{
+	case FormatArg::INT:
+	case FormatArg::CHAR:
+	case FormatArg::INT64:
+		return (double)arg.i;
+	case FormatArg::UINT:
+	case FormatArg::UINT64:
+		return (double)arg.u;
+	case FormatArg::DOUBLE:
+		return arg.d;
+	default:
+		return 0.;
+	}
+}
+
+//=================================================================================================
+static void FormatString(FormatSink& out, const FormatSpec& spec, const FormatArg& arg)
+{
+	cstring str;
+	uint length;
+	char c;
+	switch(arg.type)
+	{
+	case FormatArg::STRING:
+		str = arg.s;
+		if(!str)
+		{
+			str = "(null)";
+			length = 6;
+		}
+		else if(arg.length == UINT_MAX)
+			length = (uint)(spec.precision >= 0 ? strnlen(str, spec.precision) : strlen(str));
+		else
+			length = arg.length;
+		break;
+	case FormatArg::CHAR:
+		c = (char)arg.i;
+		str = &c;
+		length = 1;
+		break;
+	case FormatArg::POINTER:
+		if(!arg.p)
+		{
+			str = "(null)";
+			length = 6;
+			break;
+		}
+		// fallthrough
+	default:
+		{
+			// not string, use default format for type
+			FormatSpec spec2 = spec;
+			spec2.precision = -1;
+			if(arg.type == FormatArg::DOUBLE)
+			{
+				spec2.conv = 'g';
+				FormatDouble(out, spec2, arg.d);
+			}
+			else
+			{
+				spec2.conv = (arg.type == FormatArg::POINTER ? 'X' : (arg.type == FormatArg::UINT || arg.type == FormatArg::UINT64) ? 'u' : 'd');
+				FormatInteger(out, spec2, arg);
+			}
+		}
+		return;
+	}
+
+	if(spec.precision >= 0 && (uint)spec.precision < length)
+		length = spec.precision;
+	AppendPadded(out, spec, nullptr, 0, str, length);
+}
+
+//=================================================================================================
+static void FormatArgs(FormatSink& out, cstring fmt, const FormatArg* args, uint count)
+{
+	assert(fmt);
+
+	uint argIndex = 0;
+	cstring s = fmt;
+	while(true)
+	{
+		// copy text up to next specifier
+		cstring start = s;
+		while(*s && *s != '%')
+			++s;
+		if(s != start)
+			out.Append(start, uint(s - start));
+		if(!*s)
+			break;
+
+		cstring specStart = s++;
+		if(*s == '%')
+		{
+			out.Append('%');
+			++s;
+			continue;
+		}
+
+		FormatSpec spec = {};
+		spec.precision = -1;
+
+		// flags
+		bool flag = true;
+		while(flag)
+		{
+			switch(*s)
+			{
+			case '-':
+				spec.left = true;
+				break;
+			case '+':
+				spec.plus = true;
+				break;
+			case ' ':
+				spec.space = true;
+				break;
+			case '#':
+				spec.alt = true;
+				break;
+			case '0':
+				spec.zero = true;
+				break;
+			default:
+				flag = false;
+				continue;
+			}
+			++s;
+		}
+
+		// width
+		if(*s == '*')
+		{
+			++s;
+			if(argIndex < count)
+			{
+				spec.width = (int)args[argIndex++].i;
+				if(spec.width < 0)
+				{
+					spec.left = true;
+					spec.width = -spec.width;
+				}
+			}
+		}
+		else
+		{
+			while(*s >= '0' && *s <= '9')
+				spec.width = spec.width * 10 + (*s++ - '0');
+		}
+
+		// precision
+		if(*s == '.')
+		{
+			++s;
+			spec.precision = 0;
+			if(*s == '*')
+			{
+				++s;
+				if(argIndex < count)
+				{
+					spec.precision = (int)args[argIndex++].i;
+					if(spec.precision < 0)
+						spec.precision = -1;
+				}
+			}
+			else
+			{
+				while(*s >= '0' && *s <= '9')
+					spec.precision = spec.precision * 10 + (*s++ - '0');
+			}
+		}
+
+		// length modifiers, ignored - type is known from argument
+		while(*s == 'h' || *s == 'l' || *s == 'L' || *s == 'j' || *s == 'z' || *s == 't' || *s == 'q')
+			++s;
+		if(*s == 'I')
+		{
+			++s;
+			if((s[0] == '6' && s[1] == '4') || (s[0] == '3' && s[1] == '2'))
+				s += 2;
+		}
+
+		spec.conv = *s;
+		if(!spec.conv)
+		{
+			out.Append(specStart, uint(s - specStart));
+			break;
+		}
+		++s;
+
+		if(!strchr("diuxXocsfFeEgGaAp", spec.conv))
+		{
+			// unknown specifier (or %n), write as it is
+			out.Append(specStart, uint(s - specStart));
+			continue;
+		}
+
+		assert(argIndex < count && "Missing format argument.");
+		if(argIndex >= count)
+			continue;
+		const FormatArg& arg = args[argIndex++];
+
+		switch(spec.conv)
+		{
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o':
+			FormatInteger(out, spec, arg);
+			break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			FormatDouble(out, spec, ToDouble(arg));
+			break;
+		case 'c':
+			{
+				const char c = (arg.type == FormatArg::DOUBLE ? (char)arg.d : (char)arg.i);
+				AppendPadded(out, spec, nullptr, 0, &c, 1);
+			}
+			break;
+		case 's':
+			FormatString(out, spec, arg);
+			break;
+		case 'p':
+			spec.conv = 'X';
+			spec.zero = true;
+			spec.width = (int)sizeof(void*) * 2;
+			spec.precision = -1;
+			spec.alt = false;
+			FormatInteger(out, spec, arg);
+			break;
+		}
+	}
+}
+
+//=================================================================================================
+//=================================================================================================
+void FormatArgs(string& out, cstring fmt, const FormatArg* args, uint count)
+{
+	FormatSink sink(out);
+	FormatArgs(sink, fmt, args, count);
+}
+
+//=================================================================================================
+cstring FormatArgs(cstring fmt, const FormatArg* args, uint count)
+{
+	string& str = GetFormatStr();
+	FormatArgs(str, fmt, args, count);
+	return str.c_str();
+}
+
+//=================================================================================================
+uint FormatArgs(char* buf, uint size, cstring fmt, const FormatArg* args, uint count)
+{
+	assert(buf || size == 0);
+	// writes directly to buffer, this is also safe to call during static destruction
+	FormatSink sink(buf, size > 0 ? size - 1 : 0);
+	FormatArgs(sink, fmt, args, count);
+	if(size > 0)
+		buf[std::min(sink.length, size - 1)] = 0;
+	return sink.length;
+}
+
+//=================================================================================================
+cstring FormatList(cstring str, va_list list)
+{
+	assert(str);
+
+	string& s = GetFormatStr();
+	va_list copy;
+	va_copy(copy, list);
+	const int length = _vscprintf(str, copy);
+	va_end(copy);
+	if(length > 0)
+	{
+		s.resize(length);
+		_vsnprintf_s((char*)s.data(), length + 1, length, str, list);
 	}
-	va_end(list);
+	return s.c_str();
 }
 
 //=================================================================================================
@@ -308,14 +850,14 @@ void SplitText(char* buf, vector<cstring>& lines)
 }
 
 //=================================================================================================
-bool Unescape(const string& strIn, uint pos, uint size, string& strOut)
+bool Unescape(cstring strIn, uint size, string& strOut)
 {
 	strOut.clear();
-	strOut.reserve(strIn.length());
+	strOut.reserve(size);
 
 	cstring unesc = "nt\\\"'";
 	cstring esc = "\n\t\\\"'";
-	uint end = pos + size;
+	uint pos = 0, end = size;
 
 	for(; pos < end; ++pos)
 	{
@@ -324,7 +866,7 @@ bool Unescape(const string& strIn, uint pos, uint size, string& strOut)
 			++pos;
 			if(pos == end)
 			{
-				Error("Unescape error in string \"%.*s\", character '\\' at end of string.", size, strIn.c_str() + pos);
+				Error("Unescape error in string \"%.*s\", character '\\' at end of string.", size, strIn + pos);
 				return false;
 			}
 			int index = StrCharIndex(unesc, strIn[pos]);
@@ -332,7 +874,7 @@ bool Unescape(const string& strIn, uint pos, uint size, string& strOut)
 				strOut += esc[index];
 			else
 			{
-				Error("Unescape error in string \"%.*s\", unknown escape sequence '\\%c'.", size, strIn.c_str() + pos, strIn[pos]);
+				Error("Unescape error in string \"%.*s\", unknown escape sequence '\\%c'.", size, strIn + pos, strIn[pos]);
 				return false;
 			}
 		}
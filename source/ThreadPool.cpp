@@ -0,0 +1,107 @@
+#include "Pch.h"
+#include "ThreadPool.h"
+
+#include "WindowsIncludes.h"
+
+ThreadPool* app::threadPool;
+
+//=================================================================================================
+ThreadPool::ThreadPool() : semaphore(nullptr), count(0), quit(false)
+{
+}
+
+//=================================================================================================
+ThreadPool::~ThreadPool()
+{
+	Shutdown();
+}
+
+//=================================================================================================
+void ThreadPool::Init(uint count)
+{
+	assert(workers.empty());
+
+	if(count == 0)
+	{
+		const uint hardwareThreads = thread::hardware_concurrency();
+		count = hardwareThreads > 1u ? hardwareThreads - 1 : 0u;
+	}
+	if(count == 0)
+		return;
+
+	semaphore = CreateSemaphore(nullptr, 0, count, nullptr);
+	quit = false;
+	workers.reserve(count);
+	for(uint i = 0; i < count; ++i)
+		workers.push_back(thread(&ThreadPool::Run, this));
+	Info("ThreadPool: Started %u worker threads.", count);
+}
+
+//=================================================================================================
+void ThreadPool::Shutdown()
+{
+	if(workers.empty())
+		return;
+
+	quit = true;
+	ReleaseSemaphore(semaphore, workers.size(), nullptr);
+	for(thread& worker : workers)
+		worker.join();
+	workers.clear();
+	CloseHandle(semaphore);
+	semaphore = nullptr;
+}
+
+//=================================================================================================
+void ThreadPool::ParallelFor(uint count, Job job)
+{
+	assert(job);
+
+	if(workers.empty() || count <= 1u)
+	{
+		for(uint i = 0; i < count; ++i)
+			job(i);
+		return;
+	}
+
+	this->job = job;
+	this->count = count;
+	next = 0;
+
+	// wake only as many threads as there are jobs left for them
+	const uint wake = min(count - 1, (uint)workers.size());
+	working = wake;
+	ReleaseSemaphore(semaphore, wake, nullptr);
+
+	RunJobs();
+
+	// wait for woken threads to finish so next call can't be mixed with this one
+	while(working != 0u)
+		std::this_thread::yield();
+	this->job = nullptr;
+}
+
+//=================================================================================================
+void ThreadPool::Run()
+{
+	while(true)
+	{
+		WaitForSingleObject(semaphore, INFINITE);
+		if(quit)
+			break;
+		RunJobs();
+		--working;
+	}
+}
+
+//=================================================================================================
+void ThreadPool::RunJobs()
+{
+	while(true)
+	{
+		const uint index = next++;
+		if(index >= count)
+			break;
+		job(index);
+	}
+}
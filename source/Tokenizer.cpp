@@ -1,17 +1,50 @@
 #include "Pch.h"
 #include "Tokenizer.h"
+#include "Crc.h"
 #include "File.h"
 
 using namespace tokenizer;
 
 static cstring ALTER_START = "${";
 static cstring ALTER_END = "}$";
-static cstring WHITESPACE_SYMBOLS = " \t\n\r,/;'\\[]`<>?:|{}=~!@#$%^&*()+-\"";
-static cstring WHITESPACE_SYMBOLS_DOT = " \t\n\r,/;'\\[]`<>?:|{}=~!@#$%^&*()+-\".";
+static const char CACHE_SIGN[4] = { 'T', 'K', 'C', 'H' };
+static const byte CACHE_VERSION = 1;
 static cstring SYMBOLS = ",./;'\\[]`<>?:|{}=~!@#$%^&*()+-";
 
+// character classes used by lexer
+enum CharClass
+{
+	CC_SPACE = 1 << 0, // space, tab
+	CC_NEWLINE = 1 << 1, // \n, \r
+	CC_SYMBOL = 1 << 2,
+	CC_SEPARATOR = 1 << 3, // ends item (whitespace, symbol except dot, quote)
+	CC_DOT = 1 << 4,
+	CC_DIGIT = 1 << 5
+};
+
+struct CharClassTable
+{
+	byte cls[256];
+
+	CharClassTable() : cls()
+	{
+		cls[' '] = cls['\t'] = CC_SPACE | CC_SEPARATOR;
+		cls['\n'] = cls['\r'] = CC_NEWLINE | CC_SEPARATOR;
+		for(cstring s = SYMBOLS; *s; ++s)
+			cls[(byte)*s] = CC_SYMBOL | (*s == '.' ? CC_DOT : CC_SEPARATOR);
+		cls['"'] = CC_SEPARATOR;
+		for(char c = '0'; c <= '9'; ++c)
+			cls[(byte)c] = CC_DIGIT;
+	}
+
+	int operator [] (byte c) const { return cls[c]; }
+};
+static const CharClassTable charClass;
+
 //=================================================================================================
-Tokenizer::Tokenizer(int _flags) : needSorting(false), formatter(this), seek(nullptr), ownString(false)
+Tokenizer::Tokenizer(int _flags) : str(nullptr), data(""), len(0), seek(nullptr), mapping(nullptr), buf(nullptr), streamFile(nullptr), windowOffset(0),
+windowSize(DEFAULT_WINDOW_SIZE), keepPos(string::npos), streamEof(true), needMore(false), cacheIndex(0), cacheFlags(0), needSorting(false), needRebuild(false), ownString(false),
+formatter(this)
 {
 	SetFlags(_flags);
 	Reset();
@@ -21,16 +54,55 @@ Tokenizer::Tokenizer(int _flags) : needSorting(false), formatter(this), seek(nul
 Tokenizer::~Tokenizer()
 {
 	if(ownString)
+	{
 		StringPool.SafeFree(const_cast<string*>(str));
+		ownString = false;
+	}
+	FreeSource();
+	delete mapping;
 	delete seek;
 }
 
+//=================================================================================================
+void Tokenizer::FreeSource()
+{
+	if(ownString)
+	{
+		StringPool.Free(const_cast<string*>(str));
+		ownString = false;
+	}
+	str = nullptr;
+	if(buf)
+	{
+		buf->Free();
+		buf = nullptr;
+	}
+	if(mapping)
+		mapping->Close();
+	if(streamFile)
+	{
+		delete streamFile;
+		streamFile = nullptr;
+		window.clear();
+		window.shrink_to_fit();
+		windowOffset = 0;
+		streamEof = true;
+	}
+	if(!cache.empty())
+	{
+		cache.clear();
+		cacheStrings.clear();
+	}
+	data = "";
+	len = 0;
+}
+
 //=================================================================================================
 void Tokenizer::FromString(cstring _str)
 {
 	assert(_str);
-	if(!ownString)
-		str = StringPool.Get();
+	FreeSource();
+	str = StringPool.Get();
 	*const_cast<string*>(str) = _str;
 	ownString = true;
 	Reset();
@@ -39,11 +111,7 @@ void Tokenizer::FromString(cstring _str)
 //=================================================================================================
 void Tokenizer::FromString(const string& _str)
 {
-	if(ownString)
-	{
-		StringPool.Free(const_cast<string*>(str));
-		ownString = false;
-	}
+	FreeSource();
 	str = &_str;
 	Reset();
 }
@@ -52,28 +120,91 @@ void Tokenizer::FromString(const string& _str)
 bool Tokenizer::FromFile(cstring path)
 {
 	assert(path);
-	if(!ownString)
+	FreeSource();
+	if(!mapping)
+		mapping = new FileMapping;
+	if(mapping->Open(path))
 	{
+		data = (cstring)mapping->Data();
+		len = mapping->GetSize();
+	}
+	else
+	{
+		// empty file can't be mapped, load it to string
 		str = StringPool.Get();
 		ownString = true;
+		if(!io::LoadFileToString(path, *const_cast<string*>(str)))
+			return false;
 	}
-	if(!io::LoadFileToString(path, *const_cast<string*>(str)))
-		return false;
 	filename = path;
 	Reset();
 	return true;
 }
 
 //=================================================================================================
-void Tokenizer::FromTokenizer(const Tokenizer& t)
+bool Tokenizer::FromFileStream(cstring path, uint _windowSize)
 {
-	if(ownString)
+	assert(path && _windowSize > 0);
+	FreeSource();
+	streamFile = new FileReader(path);
+	if(!streamFile->IsOpen())
 	{
-		StringPool.Free(const_cast<string*>(str));
-		ownString = false;
+		delete streamFile;
+		streamFile = nullptr;
+		return false;
 	}
+	windowSize = _windowSize;
+	filename = path;
+	Reset();
+	return true;
+}
+
+//=================================================================================================
+void Tokenizer::FromBuffer(Buffer* _buf)
+{
+	assert(_buf);
+	FreeSource();
+	buf = _buf;
+	data = (cstring)buf->Data();
+	len = buf->Size();
+	Reset();
+}
+
+//=================================================================================================
+void Tokenizer::FromMemory(cstring _data, uint size)
+{
+	assert(_data || size == 0);
+	FreeSource();
+	data = _data ? _data : "";
+	len = size;
+	Reset();
+}
+
+//=================================================================================================
+bool Tokenizer::FromCache(cstring path, cstring cachePath)
+{
+	assert(path && cachePath);
+	if(!FromFile(path))
+		return false;
+
+	Crc crc;
+	crc.Update((const byte*)data, len);
+	const uint keywordsCrc = CalculateKeywordsCrc();
+	if(!LoadCache(cachePath, crc, keywordsCrc))
+		BuildCache(cachePath, crc, keywordsCrc);
+	cacheFlags = flags;
+	return true;
+}
+
+//=================================================================================================
+void Tokenizer::FromTokenizer(const Tokenizer& t)
+{
+	assert(!t.streamFile);
+	FreeSource();
 
 	str = t.str;
+	data = t.data;
+	len = t.len;
 	normalSeek.pos = t.normalSeek.pos;
 	normalSeek.line = t.normalSeek.line;
 	normalSeek.charpos = t.normalSeek.charpos;
@@ -88,20 +219,177 @@ void Tokenizer::FromTokenizer(const Tokenizer& t)
 	if(normalSeek.token == T_KEYWORD)
 	{
 		// need to check keyword because keywords are not copied from other tokenizer, it may be item here
+		CheckSorting();
 		CheckItemOrKeyword(normalSeek, normalSeek.item);
 	}
 }
 
+//=================================================================================================
+void Tokenizer::Reset()
+{
+	if(str)
+	{
+		data = str->c_str();
+		len = str->length();
+	}
+	else if(streamFile)
+		SeekWindow(0);
+	normalSeek.token = T_NONE;
+	normalSeek.pos = 0;
+	normalSeek.startPos = 0;
+	normalSeek.line = 0;
+	normalSeek.charpos = 0;
+	keepPos = string::npos;
+	cacheIndex = 0;
+}
+
+//=================================================================================================
+// Move window to offset in file, previous window content is discarded
+void Tokenizer::SeekWindow(uint offset)
+{
+	assert(streamFile);
+	const uint size = streamFile->GetSize();
+	if(offset > size)
+		offset = size;
+	streamFile->SetPos(offset);
+	windowOffset = offset;
+	streamEof = (offset == size);
+	window.resize(1);
+	window[0] = 0;
+	data = window.data();
+	len = 0;
+}
+
+//=================================================================================================
+static void ShiftSeekData(SeekData& s, uint shift)
+{
+	if(s.pos != string::npos)
+		s.pos = s.pos >= shift ? s.pos - shift : 0;
+	s.startPos = s.startPos >= shift ? s.startPos - shift : 0;
+}
+
+//=================================================================================================
+// Read data so window contains text up to end, already parsed text is discarded
+void Tokenizer::FillWindow(SeekData& s, uint end)
+{
+	if(streamEof || end <= len)
+		return;
+
+	// discard text before current tokens
+	uint keep = std::min(normalSeek.startPos, s.pos);
+	if(keepPos != string::npos)
+		keep = std::min(keep, keepPos - windowOffset);
+	keep = std::min(keep, len);
+	if(keep > 0)
+	{
+		memmove(window.data(), window.data() + keep, len - keep);
+		len -= keep;
+		end -= keep;
+		windowOffset += keep;
+		ShiftSeekData(normalSeek, keep);
+		if(seek)
+			ShiftSeekData(*seek, keep);
+		if(&s != &normalSeek && &s != seek)
+			ShiftSeekData(s, keep);
+	}
+
+	uint toRead = std::max(end - len, windowSize);
+	const uint remaining = streamFile->GetSize() - streamFile->GetPos();
+	if(toRead >= remaining)
+	{
+		toRead = remaining;
+		streamEof = true;
+	}
+	window.resize(len + toRead + 1);
+	streamFile->Read(window.data() + len, toRead);
+	len += toRead;
+	window[len] = 0;
+	data = window.data();
+}
+
 //=================================================================================================
 bool Tokenizer::DoNext(SeekData& s, bool returnEol)
 {
 	CheckSorting();
 
+	if(!cache.empty() && !returnEol && ReplayToken(s))
+		return s.token != T_EOF;
+
+	if(!streamFile)
+		return DoNextToken(s, returnEol);
+
+	// streaming mode, token must fit in window - when parsing reaches end of window read more and parse it again
+	static const uint WINDOW_MARGIN = 256;
+	if(s.token == T_EOF)
+		return false;
+	uint lookahead = windowSize;
+	while(true)
+	{
+		FillWindow(s, s.pos + lookahead);
+		const TOKEN prevToken = s.token;
+		const uint prevPos = s.pos, prevLine = s.line, prevCharpos = s.charpos;
+		needMore = false;
+		bool result = DoNextToken(s, returnEol);
+		if(streamEof || (!needMore && s.token != T_EOF && s.pos + WINDOW_MARGIN <= len))
+			return result;
+		s.token = prevToken;
+		s.pos = prevPos;
+		s.line = prevLine;
+		s.charpos = prevCharpos;
+		lookahead *= 2;
+	}
+}
+
+//=================================================================================================
+// Use cached token if it was lexed from same position, otherwise token must be parsed from text
+bool Tokenizer::ReplayToken(SeekData& s)
+{
+	if(s.token == T_EOF || flags != cacheFlags)
+		return false;
+
+	// check next token first, for sequential parsing
+	uint index = cacheIndex;
+	if(index >= cache.size() || cache[index].inputPos != s.pos)
+	{
+		auto it = std::lower_bound(cache.begin(), cache.end(), s.pos, [](const CachedToken& t, uint pos) { return t.inputPos < pos; });
+		if(it == cache.end() || it->inputPos != s.pos)
+			return false;
+		index = it - cache.begin();
+	}
+
+	const CachedToken& t = cache[index];
+	s.token = (TOKEN)t.token;
+	s.startPos = t.startPos;
+	s.pos = t.pos;
+	if(t.lines == 0)
+		s.charpos += t.charpos;
+	else
+	{
+		s.line += t.lines;
+		s.charpos = t.charpos;
+	}
+	s._int = t._int;
+	s._float = t._float;
+	s._uint = t._uint;
+	s._char = t._char;
+	if(s.token != T_EOF)
+		s.item.assign(cacheStrings.c_str() + t.itemOffset, t.itemLength);
+	if(t.checkKeyword)
+		CheckItemOrKeyword(s, s.item);
+
+	if(&s == &normalSeek)
+		cacheIndex = index + 1;
+	return true;
+}
+
+//=================================================================================================
+bool Tokenizer::DoNextToken(SeekData& s, bool returnEol)
+{
 redo:
 	if(s.token == T_EOF)
 		return false;
 
-	if(s.pos >= str->length())
+	if(s.pos >= len)
 	{
 		s.token = T_EOF;
 		return false;
@@ -109,8 +397,8 @@ redo:
 
 	s.startPos = s.pos;
 
-	// szukaj czego
-	uint pos2 = FindFirstNotOf(s, returnEol ? " \t" : " \t\n\r", s.pos);
+	// szukaj czego�
+	uint pos2 = SkipClass(s, returnEol ? CC_SPACE : CC_SPACE | CC_NEWLINE, s.pos);
 	if(pos2 == string::npos)
 	{
 		// same spacje, entery, taby
@@ -119,12 +407,13 @@ redo:
 		return false;
 	}
 
-	char c = str->at(pos2);
+	char c = data[pos2];
+	const int cls = charClass[(byte)c];
 
 	if(c == '\r')
 	{
 		s.pos = pos2 + 1;
-		if(s.pos < str->length() && str->at(s.pos) == '\n')
+		if(s.pos < len && data[s.pos] == '\n')
 			++s.pos;
 		s.token = T_EOL;
 	}
@@ -136,11 +425,11 @@ redo:
 	else if(c == '/')
 	{
 		char c2 = 0;
-		if(pos2 + 1 != str->size())
-			c2 = str->at(pos2 + 1);
+		if(pos2 + 1 != len)
+			c2 = data[pos2 + 1];
 		if(c2 == '/')
 		{
-			s.pos = FindFirstOf(s, "\n", pos2 + 1);
+			s.pos = FindChar(s, '\n', pos2 + 1);
 			if(s.pos == string::npos)
 			{
 				s.token = T_EOF;
@@ -155,7 +444,14 @@ redo:
 			int prevCharpos = s.charpos;
 			s.pos = FindFirstOfStr(s, "*/", pos2 + 1);
 			if(s.pos == string::npos)
+			{
+				if(!streamEof)
+				{
+					needMore = true;
+					return false;
+				}
 				formatter.Throw(Format("Not closed comment started at line %d, character %d.", prevLine + 1, prevCharpos + 1));
+			}
 			goto redo;
 		}
 		else
@@ -169,39 +465,45 @@ redo:
 	}
 	else if(c == '"')
 	{
-		// szukaj koca cigu znakw
+		// szukaj ko�ca ci�gu znak�w
 		uint cp = s.charpos;
 		s.pos = FindEndOfQuote(s, pos2 + 1);
 
-		if(s.pos == string::npos || str->at(s.pos) != '"')
+		if(s.pos == string::npos || data[s.pos] != '"')
+		{
+			if(!streamEof)
+			{
+				needMore = true;
+				return false;
+			}
 			formatter.Throw(Format("Not closed string \" opened at %u.", cp + 1));
+		}
 
-		Unescape(*str, pos2 + 1, s.pos - pos2 - 1, s.item);
+		Unescape(data + pos2 + 1, s.pos - pos2 - 1, s.item);
 		s.token = T_STRING;
 		++s.pos;
 	}
-	else if(StringInString(str->c_str() + pos2, ALTER_START))
+	else if(c == ALTER_START[0] && pos2 + 1 < len && data[pos2 + 1] == ALTER_START[1])
 	{
 		// alter string
-		int len = strlen(ALTER_START);
-		s.pos = pos2 + len;
-		s.charpos += len;
+		s.pos = pos2 + 2;
+		s.charpos += 2;
 		uint blockStart = s.pos;
 		bool ok = false;
-		len = strlen(ALTER_END);
 
-		for(; s.pos < str->length(); ++s.pos)
+		for(; s.pos < len; ++s.pos)
 		{
-			if(StringInString(str->c_str() + s.pos, ALTER_END))
+			const char c2 = data[s.pos];
+			if(c2 == ALTER_END[0] && s.pos + 1 < len && data[s.pos + 1] == ALTER_END[1])
 			{
-				s.item = str->substr(blockStart, s.pos - blockStart);
+				s.item.assign(data + blockStart, s.pos - blockStart);
 				s.token = T_STRING;
-				s.pos += len;
-				s.charpos += len;
+				s.pos += 2;
+				s.charpos += 2;
 				ok = true;
 				break;
 			}
-			else if(str->at(s.pos) == '\n')
+			else if(c2 == '\n')
 			{
 				++s.line;
 				s.charpos = 0;
@@ -211,11 +513,18 @@ redo:
 		}
 
 		if(!ok)
+		{
+			if(!streamEof)
+			{
+				needMore = true;
+				return false;
+			}
 			Throw("Missing closing alternate string '%s'.", ALTER_END);
+		}
 	}
 	else if(c == '-')
 	{
-		if(pos2 + 1 == str->length())
+		if(pos2 + 1 == len)
 		{
 			s.token = T_SYMBOL;
 			s._char = c;
@@ -229,22 +538,26 @@ redo:
 			int oldPos = s.pos;
 			int oldCharpos = s.charpos;
 			int oldLine = s.line;
-			// znajd nastpny znak
-			pos2 = FindFirstNotOf(s, returnEol ? " \t" : " \t\n\r", s.pos);
+			// znajd� nast�pny znak
+			pos2 = SkipClass(s, returnEol ? CC_SPACE : CC_SPACE | CC_NEWLINE, s.pos);
 			if(pos2 == string::npos)
 			{
 				// same spacje, entery, taby
 				// to koniec pliku
+				if(!streamEof)
+				{
+					needMore = true;
+					return false;
+				}
 				s.token = T_SYMBOL;
 				s._char = c;
 				s.item = c;
 			}
 			else
 			{
-				char c = str->at(pos2);
-				if(!(c >= '0' && c <= '9' && ParseNumber(s, pos2, true)))
+				if(!(IsSet(charClass[(byte)data[pos2]], CC_DIGIT) && ParseNumber(s, pos2, true)))
 				{
-					// nie liczba, zwrc minus
+					// nie liczba, zwr�c minus
 					s.token = T_SYMBOL;
 					s._char = '-';
 					s.item = '-';
@@ -255,18 +568,25 @@ redo:
 			}
 		}
 	}
-	else if(strchr(SYMBOLS, c))
+	else if(IsSet(cls, CC_SYMBOL))
 	{
 		if(c == '\'' && IsSet(flags, F_CHAR))
 		{
 			// char
 			uint cp = s.charpos;
-			s.pos = FindFirstOf(s, "'", pos2 + 1);
+			s.pos = FindChar(s, '\'', pos2 + 1);
 
 			if(s.pos == string::npos)
+			{
+				if(!streamEof)
+				{
+					needMore = true;
+					return false;
+				}
 				formatter.Throw(Format("Not closed char ' opened at %u.", cp + 1));
+			}
 
-			Unescape(*str, pos2 + 1, s.pos - pos2 - 1, s.item);
+			Unescape(data + pos2 + 1, s.pos - pos2 - 1, s.item);
 
 			if(s.item.empty())
 				formatter.Throw(Format("Empty char sequence at %u.", cp + 1));
@@ -287,25 +607,21 @@ redo:
 			s.item = c;
 		}
 	}
-	else if(c >= '0' && c <= '9')
+	else if(IsSet(cls, CC_DIGIT))
 	{
 		// number
-		if(c == '0' && pos2 + 1 != str->size() && (str->at(pos2 + 1) == 'x' || str->at(pos2 + 1) == 'X'))
+		if(c == '0' && pos2 + 1 != len && (data[pos2 + 1] == 'x' || data[pos2 + 1] == 'X'))
 		{
 			// hex number
-			s.pos = FindFirstOf(s, WHITESPACE_SYMBOLS_DOT, pos2);
-			if(pos2 == string::npos)
-			{
-				s.pos = str->length();
-				s.item = str->substr(pos2);
-			}
-			else
-				s.item = str->substr(pos2, s.pos - pos2);
+			s.pos = FindClass(s, CC_SEPARATOR | CC_DOT, pos2);
+			if(s.pos == string::npos)
+				s.pos = len;
+			s.item.assign(data + pos2, s.pos - pos2);
 
 			uint num = 0;
-			for(uint i = 2; i < s.item.length(); ++i)
+			for(uint i = pos2 + 2; i < s.pos; ++i)
 			{
-				c = tolower(s.item[i]);
+				c = data[i];
 				if(c >= '0' && c <= '9')
 				{
 					num <<= 4;
@@ -339,19 +655,11 @@ redo:
 	else
 	{
 		// find end of this item
-		bool ignoreDot = false;
-		if(IsSet(flags, F_JOIN_DOT))
-			ignoreDot = true;
-		s.pos = FindFirstOf(s, ignoreDot ? WHITESPACE_SYMBOLS : WHITESPACE_SYMBOLS_DOT, pos2);
-		if(pos2 == string::npos)
-		{
-			s.pos = str->length();
-			s.item = str->substr(pos2);
-		}
-		else
-			s.item = str->substr(pos2, s.pos - pos2);
-
-		CheckItemOrKeyword(s, s.item);
+		s.pos = FindClass(s, IsSet(flags, F_JOIN_DOT) ? CC_SEPARATOR : CC_SEPARATOR | CC_DOT, pos2);
+		if(s.pos == string::npos)
+			s.pos = len;
+		s.item.assign(data + pos2, s.pos - pos2);
+		CheckItemOrKeyword(s, std::string_view(data + pos2, s.pos - pos2));
 	}
 
 	return true;
@@ -360,112 +668,113 @@ redo:
 //=================================================================================================
 bool Tokenizer::ParseNumber(SeekData& s, uint pos2, bool negative)
 {
-	s.item.clear();
-	if(negative)
-		s.item = "-";
+	const uint start = pos2;
+	int64 val = 0;
+	float f = 0.f;
+	uint diver = 10;
 	int haveDot = 0;
 	/*
 	0 - number
 	1 - number.
 	2 - number.number
-	3 - number.number.
 	*/
 
-	uint len = str->length();
-	do
+	// value is calculated while scanning (same way as TextHelper::ToNumber)
+	for(; pos2 < len; ++pos2, ++s.charpos)
 	{
-		if(pos2 >= len)
+		const char c = data[pos2];
+		const int cls = charClass[(byte)c];
+		if(IsSet(cls, CC_DIGIT))
 		{
-			// eof
-			s.pos = pos2;
-			break;
-		}
-
-		char c = str->at(pos2);
-		if(c >= '0' && c <= '9')
-		{
-			s.item += c;
-			if(haveDot == 1)
+			if(haveDot == 0)
+				val = val * 10 + (c - '0');
+			else
+			{
 				haveDot = 2;
+				f += ((float)(c - '0')) / diver;
+				diver *= 10;
+			}
 		}
 		else if(c == '.')
 		{
-			if(haveDot == 0)
-			{
-				haveDot = 1;
-				s.item += c;
-			}
-			else
-			{
-				// second dot, end parsing
-				s.pos = pos2;
+			// second dot ends parsing
+			if(haveDot != 0)
 				break;
-			}
+			haveDot = 1;
+			f = (float)val;
 		}
-		else if(CharInStr(c, WHITESPACE_SYMBOLS) != 0)
+		else if(IsSet(cls, CC_SEPARATOR))
 		{
-			// found symbol or whitespace, break
-			s.pos = pos2;
+			// found symbol or whitespace
+			break;
+		}
+		else if(haveDot == 1)
+		{
+			// int dot item, return int and leave dot
+			--pos2;
+			--s.charpos;
+			haveDot = 0;
 			break;
 		}
 		else
 		{
-			if(haveDot == 0 || haveDot == 2)
-			{
-				// int item -> broken number
-				// int . int item -> broken number
-				// find end of item
-				s.pos = FindFirstOf(s, WHITESPACE_SYMBOLS_DOT, pos2);
-				if(s.pos == string::npos)
-					s.item += str->substr(pos2);
-				else
-					s.item += str->substr(pos2, s.pos - pos2);
-				s.token = T_ITEM;
-				return false;
-			}
-			else if(haveDot == 1 || haveDot == 3)
-			{
-				// int dot item
-				s.pos = pos2 - 1;
-				s.item.pop_back();
-				return true;
-			}
+			// int item -> broken number
+			// int . int item -> broken number
+			// find end of item
+			s.pos = FindClass(s, CC_SEPARATOR | CC_DOT, pos2);
+			if(s.pos == string::npos)
+				s.pos = len;
+			SetNumberItem(s, start, s.pos, negative);
+			s.token = T_ITEM;
+			return false;
 		}
-
-		++pos2;
-		++s.charpos;
 	}
-	while(1);
+	s.pos = pos2;
+	SetNumberItem(s, start, pos2, negative);
 
-	// parse number
-	int64 val;
-	TextHelper::ParseResult result = TextHelper::ToNumber(s.item.c_str(), val, s._float);
-	if(result == TextHelper::Broken)
+	if(val > std::numeric_limits<uint>::max())
 	{
 		s.token = T_ITEM;
 		return false;
 	}
-	if(result == TextHelper::Float)
+	if(negative)
+		val = -val;
+	if(haveDot != 0)
 	{
 		s.token = T_FLOAT;
+		s._float = (negative ? -f : f);
 		s._int = (int)val;
 		s._uint = (s._int < 0 ? 0 : s._int);
 	}
 	else if(val > std::numeric_limits<int>::max())
 	{
 		s.token = T_UINT;
+		s._float = (float)val;
 		s._int = (int)val;
 		s._uint = (uint)val;
 	}
 	else
 	{
 		s.token = T_INT;
+		s._float = (float)val;
 		s._int = (int)val;
 		s._uint = (s._int < 0 ? 0 : s._int);
 	}
 	return true;
 }
 
+//=================================================================================================
+void Tokenizer::SetNumberItem(SeekData& s, uint start, uint end, bool negative)
+{
+	if(negative)
+	{
+		s.item = '-';
+		s.item.append(data + start, end - start);
+	}
+	else
+		s.item.assign(data + start, end - start);
+}
+
 //=================================================================================================
 void Tokenizer::SetFlags(int _flags)
 {
@@ -483,37 +792,39 @@ void Tokenizer::SetFlags(int _flags)
 }
 
 //=================================================================================================
-void Tokenizer::CheckItemOrKeyword(SeekData& s, const string& _item)
+void Tokenizer::CheckItemOrKeyword(SeekData& s, std::string_view item)
 {
-	Keyword k = { _item.c_str(), 0, 0 };
-	auto end = keywords.end();
-	auto it = std::lower_bound(keywords.begin(), end, k);
-	if(it != end && _item == it->name)
+	s.token = T_ITEM;
+	if(keywordTable.empty())
+		return;
+
+	const uint len = item.length();
+	const uint hash = Hash(item.data(), len);
+	const uint mask = keywordTable.size() - 1;
+	for(uint index = hash & mask;; index = (index + 1) & mask)
 	{
-		// keyword
-		s.token = T_KEYWORD;
-		s.keyword.clear();
-		if(it->enabled)
-			s.keyword.push_back(&*it);
-		if(IsSet(flags, F_MULTI_KEYWORDS))
+		const KeywordEntry& e = keywordTable[index];
+		if(!e.name)
 		{
-			do
+			// normal text, item
+			return;
+		}
+		if(e.hash == hash && e.len == len && memcmp(e.name, item.data(), len) == 0)
+		{
+			uint count;
+			if(IsSet(flags, F_MULTI_KEYWORDS))
+				count = e.count;
+			else
+				count = e.firstEnabled ? 1 : 0;
+			if(count != 0)
 			{
-				++it;
-				if(it == end || _item != it->name)
-					break;
-				if(it->enabled)
-					s.keyword.push_back(&*it);
+				// keyword
+				s.token = T_KEYWORD;
+				s.keyword.ptr = keywordRefs.data() + e.offset;
+				s.keyword.count = count;
 			}
-			while(true);
+			return;
 		}
-		if(s.keyword.empty())
-			s.token = T_ITEM;
-	}
-	else
-	{
-		// normal text, item
-		s.token = T_ITEM;
 	}
 }
 
@@ -523,13 +834,20 @@ bool Tokenizer::NextLine()
 	if(IsEof())
 		return false;
 
-	if(normalSeek.pos >= str->length())
+	if(streamFile)
+	{
+		// whole line must be inside window
+		while(!streamEof && !memchr(data + normalSeek.pos, '\n', len - normalSeek.pos))
+			FillWindow(normalSeek, len + windowSize);
+	}
+
+	if(normalSeek.pos >= len)
 	{
 		normalSeek.token = T_EOF;
 		return false;
 	}
 
-	uint pos2 = FindFirstNotOf(normalSeek, " \t", normalSeek.pos);
+	uint pos2 = SkipClass(normalSeek, CC_SPACE, normalSeek.pos);
 	if(pos2 == string::npos)
 	{
 		normalSeek.pos = string::npos;
@@ -537,11 +855,11 @@ bool Tokenizer::NextLine()
 		return false;
 	}
 
-	uint pos3 = FindFirstOf(normalSeek, "\n\r", pos2 + 1);
+	uint pos3 = FindClass(normalSeek, CC_NEWLINE, pos2 + 1);
 	if(pos3 == string::npos)
-		normalSeek.item = str->substr(pos2);
+		normalSeek.item.assign(data + pos2, len - pos2);
 	else
-		normalSeek.item = str->substr(pos2, pos3 - pos2);
+		normalSeek.item.assign(data + pos2, pos3 - pos2);
 
 	normalSeek.token = T_ITEM;
 	normalSeek.pos = pos3;
@@ -552,9 +870,9 @@ bool Tokenizer::NextLine()
 bool Tokenizer::PeekSymbol(char symbol)
 {
 	assert(normalSeek.token == T_SYMBOL || normalSeek.token == T_COMPOUND_SYMBOL);
-	if(str->size() == normalSeek.pos)
+	if(len == normalSeek.pos)
 		return false;
-	char c = str->at(normalSeek.pos);
+	char c = data[normalSeek.pos];
 	if(c == symbol)
 	{
 		normalSeek.item += c;
@@ -569,26 +887,33 @@ bool Tokenizer::PeekSymbol(char symbol)
 }
 
 //=================================================================================================
-uint Tokenizer::FindFirstNotOf(SeekData& s, cstring _str, uint _start)
+uint Tokenizer::SkipClass(SeekData& s, int mask, uint start)
 {
-	assert(_start < str->length());
-
-	uint len = strlen(_str);
-	for(uint i = _start, end = str->length(); i < end; ++i)
+	for(uint i = start; i < len; ++i)
 	{
-		char c = str->at(i);
-		bool found = false;
+		const char c = data[i];
+		if(!IsSet(charClass[(byte)c], mask))
+			return i;
 
-		for(uint j = 0; j < len; ++j)
+		if(c == '\n')
 		{
-			if(c == _str[j])
-			{
-				found = true;
-				break;
-			}
+			++s.line;
+			s.charpos = 0;
 		}
+		else
+			++s.charpos;
+	}
 
-		if(!found)
+	return string::npos;
+}
+
+//=================================================================================================
+uint Tokenizer::FindClass(SeekData& s, int mask, uint start)
+{
+	for(uint i = start; i < len; ++i)
+	{
+		const char c = data[i];
+		if(IsSet(charClass[(byte)c], mask))
 			return i;
 
 		if(c == '\n')
@@ -604,20 +929,13 @@ uint Tokenizer::FindFirstNotOf(SeekData& s, cstring _str, uint _start)
 }
 
 //=================================================================================================
-uint Tokenizer::FindFirstOf(SeekData& s, cstring _str, uint _start)
+uint Tokenizer::FindChar(SeekData& s, char ch, uint start)
 {
-	assert(_start < str->length());
-
-	uint len = strlen(_str);
-	for(uint i = _start, end = str->length(); i < end; ++i)
+	for(uint i = start; i < len; ++i)
 	{
-		char c = str->at(i);
-
-		for(uint j = 0; j < len; ++j)
-		{
-			if(c == _str[j])
-				return i;
-		}
+		const char c = data[i];
+		if(c == ch)
+			return i;
 
 		if(c == '\n')
 		{
@@ -634,11 +952,11 @@ uint Tokenizer::FindFirstOf(SeekData& s, cstring _str, uint _start)
 //=================================================================================================
 uint Tokenizer::FindFirstOfStr(SeekData& s, cstring _str, uint _start)
 {
-	assert(_start < str->length());
+	assert(_start < len);
 
-	for(uint i = _start, end = str->length(); i < end; ++i)
+	for(uint i = _start; i < len; ++i)
 	{
-		char c = str->at(i);
+		char c = data[i];
 		if(c == _str[0])
 		{
 			cstring _s = _str;
@@ -649,9 +967,9 @@ uint Tokenizer::FindFirstOfStr(SeekData& s, cstring _str, uint _start)
 				++_s;
 				if(*_s == 0)
 					return i;
-				if(i == end)
+				if(i == len)
 					return string::npos;
-				if(*_s != str->at(i))
+				if(*_s != data[i])
 					break;
 			}
 		}
@@ -670,16 +988,16 @@ uint Tokenizer::FindFirstOfStr(SeekData& s, cstring _str, uint _start)
 //=================================================================================================
 uint Tokenizer::FindEndOfQuote(SeekData& s, uint _start)
 {
-	if(_start >= str->length())
+	if(_start >= len)
 		return string::npos;
 
-	for(uint i = _start, end = str->length(); i < end; ++i)
+	for(uint i = _start; i < len; ++i)
 	{
-		char c = str->at(i);
+		char c = data[i];
 
 		if(c == '"')
 		{
-			if(i == _start || str->at(i - 1) != '\\')
+			if(i == _start || data[i - 1] != '\\')
 				return i;
 		}
 		else if(c == '\n')
@@ -743,6 +1061,7 @@ bool Tokenizer::RemoveKeyword(cstring name, int id, int group)
 		{
 			// found
 			keywords.erase(it);
+			needRebuild = true;
 			return true;
 		}
 
@@ -757,6 +1076,7 @@ bool Tokenizer::RemoveKeyword(cstring name, int id, int group)
 				if(it->id == id && it->group == group)
 				{
 					keywords.erase(it);
+					needRebuild = true;
 					return true;
 				}
 			}
@@ -775,6 +1095,7 @@ bool Tokenizer::RemoveKeyword(int id, int group)
 		if(it->id == id && it->group == group)
 		{
 			keywords.erase(it);
+			needRebuild = true;
 			return true;
 		}
 	}
@@ -802,6 +1123,7 @@ void Tokenizer::EnableKeywordGroup(int group)
 		if(k.group == group)
 			k.enabled = true;
 	}
+	needRebuild = true;
 }
 
 //=================================================================================================
@@ -812,6 +1134,7 @@ void Tokenizer::DisableKeywordGroup(int group)
 		if(k.group == group)
 			k.enabled = false;
 	}
+	needRebuild = true;
 }
 
 //=================================================================================================
@@ -905,16 +1228,160 @@ cstring Tokenizer::FormatToken(TOKEN token, int* what, int* what2)
 //=================================================================================================
 void Tokenizer::CheckSorting()
 {
-	if(!needSorting)
-		return;
+	if(needSorting)
+	{
+		needSorting = false;
+		needRebuild = true;
+		std::sort(keywords.begin(), keywords.end());
+
+		if(!IsSet(flags, F_MULTI_KEYWORDS))
+		{
+			assert(CheckMultiKeywords());
+		}
+	}
+
+	if(needRebuild)
+		BuildKeywordTable();
+}
+
+//=================================================================================================
+uint Tokenizer::CalculateKeywordsCrc()
+{
+	CheckSorting();
+
+	Crc crc;
+	crc.Update(flags);
+	for(const Keyword& k : keywords)
+	{
+		crc.Update(k.name);
+		crc.Update(k.id);
+		crc.Update(k.group);
+	}
+	return crc;
+}
+
+//=================================================================================================
+bool Tokenizer::LoadCache(cstring cachePath, uint crc, uint keywordsCrc)
+{
+	FileReader f(cachePath);
+	if(!f)
+		return false;
+
+	char sign[4];
+	byte version;
+	uint tokenSize, fileCrc, fileKeywordsCrc, size;
+	f.Read(sign, sizeof(sign));
+	f >> version;
+	f >> tokenSize;
+	f >> fileCrc;
+	f >> fileKeywordsCrc;
+	f >> size;
+	if(!f || memcmp(sign, CACHE_SIGN, sizeof(sign)) != 0 || version != CACHE_VERSION || tokenSize != sizeof(CachedToken) || fileCrc != crc || fileKeywordsCrc != keywordsCrc
+		|| size != len)
+		return false;
+
+	f.ReadVector4(cache);
+	f.ReadString4(cacheStrings);
+	if(!f || cache.empty() || !VerifyCache())
+	{
+		cache.clear();
+		cacheStrings.clear();
+		return false;
+	}
+	return true;
+}
 
-	needSorting = false;
-	std::sort(keywords.begin(), keywords.end());
+//=================================================================================================
+// Check if cached tokens are inside file & strings and sorted by input position
+bool Tokenizer::VerifyCache() const
+{
+	uint prevPos = 0;
+	for(uint i = 0, count = (uint)cache.size(); i < count; ++i)
+	{
+		const CachedToken& t = cache[i];
+		if(t.token <= T_NONE || t.token > T_COMPOUND_SYMBOL
+			|| (i != 0 && t.inputPos <= prevPos)
+			|| t.inputPos > len || t.startPos > len || t.pos > len
+			|| t.itemOffset > cacheStrings.size() || t.itemLength > cacheStrings.size() - t.itemOffset)
+			return false;
+		prevPos = t.inputPos;
+	}
+	return cache.back().token == T_EOF;
+}
 
-	if(!IsSet(flags, F_MULTI_KEYWORDS))
+//=================================================================================================
+void Tokenizer::BuildCache(cstring cachePath, uint crc, uint keywordsCrc)
+{
+	std::unordered_map<string, uint> strings;
+	SeekData s;
+	s.token = T_NONE;
+	s.pos = 0;
+	s.startPos = 0;
+	s.line = 0;
+	s.charpos = 0;
+
+	// lex whole file, on error cache isn't used (error will be reported when parsing)
+	try
 	{
-		assert(CheckMultiKeywords());
+		do
+		{
+			CachedToken t;
+			t.inputPos = s.pos;
+			const uint line = s.line, charpos = s.charpos;
+			DoNextToken(s, false);
+
+			t.startPos = s.startPos;
+			t.pos = s.pos;
+			t.lines = s.line - line;
+			t.charpos = (t.lines == 0 ? s.charpos - charpos : s.charpos);
+			t._int = s._int;
+			t._float = s._float;
+			t._uint = s._uint;
+			t._char = s._char;
+			t.token = (byte)s.token;
+			// items starting with digit or minus are broken numbers, they are never keywords
+			t.checkKeyword = (s.token == T_ITEM || s.token == T_KEYWORD) && !s.item.empty() && s.item[0] != '-'
+				&& !IsSet(charClass[(byte)s.item[0]], CC_DIGIT);
+			if(s.token != T_EOF)
+			{
+				auto it = strings.find(s.item);
+				if(it == strings.end())
+				{
+					t.itemOffset = cacheStrings.size();
+					cacheStrings += s.item;
+					strings[s.item] = t.itemOffset;
+				}
+				else
+					t.itemOffset = it->second;
+				t.itemLength = s.item.length();
+			}
+			else
+			{
+				t.itemOffset = 0;
+				t.itemLength = 0;
+			}
+			cache.push_back(t);
+		}
+		while(s.token != T_EOF);
+	}
+	catch(const Exception&)
+	{
+		cache.clear();
+		cacheStrings.clear();
+		return;
 	}
+
+	FileWriter f(cachePath);
+	if(!f.IsOpen())
+		return;
+	f.Write(CACHE_SIGN, sizeof(CACHE_SIGN));
+	f << CACHE_VERSION;
+	f << (uint)sizeof(CachedToken);
+	f << crc;
+	f << keywordsCrc;
+	f << len;
+	f.WriteVector4(cache);
+	f.WriteString4(cacheStrings);
 }
 
 //=================================================================================================
@@ -943,6 +1410,42 @@ bool Tokenizer::CheckMultiKeywords() const
 		return true;
 }
 
+//=================================================================================================
+void Tokenizer::BuildKeywordTable()
+{
+	needRebuild = false;
+	keywordRefs.clear();
+
+	uint tableSize = 16;
+	while(tableSize < keywords.size() * 2)
+		tableSize *= 2;
+	keywordTable.assign(tableSize, KeywordEntry{});
+	const uint mask = tableSize - 1;
+
+	// keywords are sorted, same names are next to each other
+	for(uint i = 0, count = keywords.size(); i < count;)
+	{
+		const Keyword& first = keywords[i];
+		KeywordEntry e;
+		e.name = first.name;
+		e.len = strlen(first.name);
+		e.hash = Hash(first.name, e.len);
+		e.offset = keywordRefs.size();
+		e.firstEnabled = first.enabled;
+		for(; i < count && strcmp(keywords[i].name, first.name) == 0; ++i)
+		{
+			if(keywords[i].enabled)
+				keywordRefs.push_back(&keywords[i]);
+		}
+		e.count = keywordRefs.size() - e.offset;
+
+		uint index = e.hash & mask;
+		while(keywordTable[index].name)
+			index = (index + 1) & mask;
+		keywordTable[index] = e;
+	}
+}
+
 //=================================================================================================
 void Tokenizer::ParseFlags(int group, int& flags)
 {
@@ -1232,6 +1735,7 @@ const string& Tokenizer::GetBlock(char open, char close, bool includeSymbol)
 	AssertSymbol(open);
 	int opened = 1;
 	uint blockStart = normalSeek.pos - 1;
+	keepPos = blockStart + windowOffset;
 	while(Next())
 	{
 		if(IsSymbol(open))
@@ -1241,15 +1745,18 @@ const string& Tokenizer::GetBlock(char open, char close, bool includeSymbol)
 			--opened;
 			if(opened == 0)
 			{
+				blockStart = keepPos - windowOffset;
+				keepPos = string::npos;
 				if(includeSymbol)
-					normalSeek.item = str->substr(blockStart, normalSeek.pos - blockStart);
+					normalSeek.item.assign(data + blockStart, normalSeek.pos - blockStart);
 				else
-					normalSeek.item = str->substr(blockStart + 1, normalSeek.pos - blockStart - 2);
+					normalSeek.item.assign(data + blockStart + 1, normalSeek.pos - blockStart - 2);
 				return normalSeek.item;
 			}
 		}
 	}
 
+	keepPos = string::npos;
 	int symbol = (int)open;
 	Unexpected(T_SYMBOL, &symbol);
 }
@@ -1435,14 +1942,16 @@ Pos Tokenizer::GetPos()
 	Pos p{};
 	p.line = normalSeek.line + 1;
 	p.charpos = normalSeek.charpos + 1;
-	p.pos = normalSeek.startPos;
+	p.pos = normalSeek.startPos + windowOffset;
 	return p;
 }
 
 //=================================================================================================
 void Tokenizer::MoveTo(const Pos& p)
 {
-	normalSeek.pos = p.pos;
+	if(streamFile && (p.pos < windowOffset || p.pos > windowOffset + len))
+		SeekWindow(p.pos);
+	normalSeek.pos = p.pos - windowOffset;
 	normalSeek.token = T_NONE;
 	DoNext(normalSeek, false);
 	normalSeek.line = p.line - 1;
@@ -1514,7 +2023,15 @@ cstring Tokenizer::GetTextRest()
 {
 	if(normalSeek.pos == string::npos)
 		return "";
-	return str->c_str() + normalSeek.pos;
+	if(streamFile)
+		FillWindow(normalSeek, std::numeric_limits<uint>::max());
+	else if(!str)
+	{
+		// mapped memory isn't null terminated
+		tmpId.assign(data + normalSeek.pos, len - normalSeek.pos);
+		return tmpId.c_str();
+	}
+	return data + normalSeek.pos;
 }
 
 //=================================================================================================
@@ -5,7 +5,8 @@
 
 struct Pak
 {
-	static const byte CURRENT_VERSION = 1;
+	static const byte CURRENT_VERSION = 2;
+	static constexpr uint CHUNK_SIZE = 64 * 1024;
 
 	struct Header
 	{
@@ -32,6 +33,9 @@ struct Pak
 		uint offset;
 	};
 
+	bool IsChunked(const File& f) const { return version >= 2 && f.compressedSize != f.size && f.size > CHUNK_SIZE; }
+	static uint GetChunkCount(uint size) { return (size + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+
 	enum Flags
 	{
 		F_ENCRYPTION = 1 << 0,
@@ -45,6 +49,7 @@ struct Pak
 		File* fileTable;
 	};
 	uint fileCount;
+	byte version;
 	bool encrypted;
 
 	~Pak()
@@ -159,6 +164,9 @@ struct Paker
 			Pak::File& f = pak->fileTable[i];
 			if(f.compressedSize == f.size)
 				printf("  %s - size %s, offset %u\n", f.filename, GetSize(f.size), f.offset);
+			else if(pak->IsChunked(f))
+				printf("  %s - size %s, compressed %s in %u chunks, offset %u\n", f.filename, GetSize(f.size), GetSize(f.compressedSize),
+					Pak::GetChunkCount(f.size), f.offset);
 			else
 				printf("  %s - size %s, compressed %s, offset %u\n", f.filename, GetSize(f.size), GetSize(f.compressedSize), f.offset);
 			totalSize += f.size;
@@ -172,7 +180,7 @@ struct Paker
 
 	void DisplayHelp()
 	{
-		printf("CaRpg paker v1. Switches:\n"
+		printf("CaRpg paker v2. Switches:\n"
 			"-?/h/help - help\n"
 			"-e/encrypt pswd - encrypt file entries with password\n"
 			"-fe/fullencrypt pswd - full encrypt with password\n"
@@ -251,7 +259,7 @@ struct Paker
 			printf("ERROR: Invalid file signature.\n");
 			return nullptr;
 		}
-		if(header.version != Pak::CURRENT_VERSION)
+		if(header.version < 1 || header.version > Pak::CURRENT_VERSION)
 		{
 			printf("ERROR: Unsupported version %u (current version is %u).\n", header.version, Pak::CURRENT_VERSION);
 			return nullptr;
@@ -280,6 +288,7 @@ struct Paker
 
 			io::Crypt((char*)pak->table, header.fileEntryTableSize, decryptKey.c_str(), decryptKey.length());
 		}
+		pak->version = header.version;
 		pak->encrypted = (header.flags & Pak::F_FULL_ENCRYPTION) != 0;
 		pak->fileCount = header.fileCount;
 
@@ -472,10 +481,15 @@ struct Paker
 
 			// compress & encrypt
 			f.size = buf->Size();
-			buf = buf->TryCompress();
+			if(f.size > Pak::CHUNK_SIZE)
+				buf = CompressChunked(buf);
+			else
+			{
+				buf = buf->TryCompress();
+				if(fullEncrypt)
+					io::Crypt((char*)buf->Data(), buf->Size(), cryptKey.c_str(), cryptKey.length());
+			}
 			f.compressedSize = buf->Size();
-			if(fullEncrypt)
-				io::Crypt((char*)buf->Data(), f.compressedSize, cryptKey.c_str(), cryptKey.length());
 
 			// write
 			pak.Write(buf->Data(), buf->Size());
@@ -541,6 +555,95 @@ struct Paker
 		return true;
 	}
 
+	// Split file into independently compressed (and encrypted) chunks preceded by table of chunk end offsets,
+	// if it isn't smaller then return whole file uncompressed
+	Buffer* CompressChunked(Buffer* buf)
+	{
+		const uint size = buf->Size();
+		const uint count = Pak::GetChunkCount(size);
+		const uint tableSize = sizeof(uint) * count;
+		Buffer* result = Buffer::Get();
+		result->Resize(tableSize);
+		uint end = 0;
+		for(uint i = 0; i < count; ++i)
+		{
+			const uint offset = i * Pak::CHUNK_SIZE;
+			const uint chunkSize = min(size - offset, Pak::CHUNK_SIZE);
+			byte* data = (byte*)buf->At(offset);
+			const uint start = result->Size();
+			Buffer* chunk = io::TryCompress(data, chunkSize);
+			if(chunk)
+			{
+				result->Append(chunk->Data(), chunk->Size());
+				chunk->Free();
+			}
+			else
+				result->Append(data, chunkSize);
+			if(fullEncrypt)
+				io::Crypt((char*)result->At(start), result->Size() - start, cryptKey.c_str(), cryptKey.length());
+			end += result->Size() - start;
+			memcpy(result->At(sizeof(uint) * i), &end, sizeof(uint));
+		}
+		if(fullEncrypt)
+			io::Crypt((char*)result->Data(), tableSize, cryptKey.c_str(), cryptKey.length());
+
+		if(result->Size() < size)
+		{
+			buf->Free();
+			return result;
+		}
+
+		result->Free();
+		if(fullEncrypt)
+			io::Crypt((char*)buf->Data(), size, cryptKey.c_str(), cryptKey.length());
+		return buf;
+	}
+
+	Buffer* DecompressChunked(Pak* pak, Pak::File& f, Buffer* data)
+	{
+		const uint count = Pak::GetChunkCount(f.size);
+		const uint tableSize = sizeof(uint) * count;
+		if(tableSize > data->Size())
+		{
+			data->Free();
+			return nullptr;
+		}
+		if(pak->encrypted)
+			io::Crypt((char*)data->Data(), tableSize, decryptKey.c_str(), decryptKey.length());
+
+		Buffer* result = Buffer::Get();
+		result->Resize(f.size);
+		const uint* ends = (const uint*)data->Data();
+		uint begin = 0;
+		for(uint i = 0; i < count; ++i)
+		{
+			const uint rawSize = min(f.size - i * Pak::CHUNK_SIZE, Pak::CHUNK_SIZE);
+			if(ends[i] < begin || ends[i] - begin > rawSize || tableSize + ends[i] > data->Size())
+			{
+				data->Free();
+				result->Free();
+				return nullptr;
+			}
+			const uint chunkSize = ends[i] - begin;
+			byte* src = (byte*)data->At(tableSize + begin);
+			if(pak->encrypted)
+				io::Crypt((char*)src, chunkSize, decryptKey.c_str(), decryptKey.length());
+			byte* dst = (byte*)result->At(i * Pak::CHUNK_SIZE);
+			if(chunkSize == rawSize)
+				memcpy(dst, src, rawSize);
+			else
+			{
+				Buffer* chunk = io::Decompress(src, chunkSize, rawSize);
+				memcpy(dst, chunk->Data(), rawSize);
+				chunk->Free();
+			}
+			begin = ends[i];
+		}
+
+		data->Free();
+		return result;
+	}
+
 	void UnpackPak(cstring path)
 	{
 		doneAnything = true;
@@ -562,13 +665,26 @@ struct Paker
 				continue;
 			}
 
-			// decrypt
-			if(pak->encrypted)
-				io::Crypt((char*)buf->Data(), buf->Size(), decryptKey.c_str(), decryptKey.length());
+			if(pak->IsChunked(f))
+			{
+				// decrypt & decompress each chunk
+				buf = DecompressChunked(pak, f, buf);
+				if(!buf)
+				{
+					printf("  ERROR: Broken chunk table (name %s).\n", f.filename);
+					continue;
+				}
+			}
+			else
+			{
+				// decrypt
+				if(pak->encrypted)
+					io::Crypt((char*)buf->Data(), buf->Size(), decryptKey.c_str(), decryptKey.length());
 
-			// decompress
-			if(f.compressedSize != f.size)
-				buf = buf->Decompress(f.size);
+				// decompress
+				if(f.compressedSize != f.size)
+					buf = buf->Decompress(f.size);
+			}
 
 			// save
 			FileWriter::WriteAll(f.filename, buf);